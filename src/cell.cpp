@@ -10,6 +10,7 @@ Int use_count(const Cell& cell)
         [](const VectorPtr& p) -> Int { return p.use_count(); },
         [](const SymenvPtr& p) -> Int { return p.use_count(); },
         [](const FunctionPtr& p) -> Int { return p.use_count(); },
+        [](const RecordPtr& p) -> Int { return p.use_count(); },
         [](auto&) -> Int { return 0; },
     };
     return std::visit(pointer, static_cast<const Cell::base_type&>(cell));
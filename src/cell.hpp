@@ -25,6 +25,22 @@ struct Cell : Variant {
     using Variant::Variant;
 };
 
+/**
+ * Record of a record type, defined by define-record-type.
+ *
+ * A record type descriptor is a record itself, without record type, whose slots are
+ * the type name followed by the field names.
+ */
+struct Record {
+    Record(const RecordPtr& type, size_t size, std::pmr::memory_resource* mres)
+        : type{ type }
+        , slots(size, none, mres)
+    {
+    }
+    RecordPtr type; //!< Record type descriptor or null-pointer for a descriptor.
+    Vector slots; //!< Field values of a record.
+};
+
 template <typename CellType>
 struct bad_cell_access;
 
@@ -113,6 +129,7 @@ inline bool is_char   (const Cell& cell) { return is_type<Char>(cell); }
 inline bool is_string (const Cell& cell) { return is_type<StringPtr>(cell); }
 inline bool is_regex  (const Cell& cell) { return is_type<RegexPtr>(cell); }
 inline bool is_dict   (const Cell& cell) { return is_type<MapPtr>(cell); }
+inline bool is_record (const Cell& cell) { return is_type<RecordPtr>(cell); }
 inline bool is_pair   (const Cell& cell) { return is_type<Cons*>(cell); }
 inline bool is_intern (const Cell& cell) { return is_type<Intern>(cell); }
 inline bool is_port   (const Cell& cell) { return is_type<PortPtr>(cell); }
@@ -128,6 +145,7 @@ inline bool is_false  (const Cell& cell) { return is_type<Bool>(cell) && !get<Bo
 inline bool is_true   (const Cell& cell) { return !is_type<Bool>(cell) || get<Bool>(cell); }
 inline bool is_else   (const Cell& cell) { return is_intern(cell) && get<Intern>(cell) == Intern::_else; }
 inline bool is_arrow  (const Cell& cell) { return is_intern(cell) && get<Intern>(cell) == Intern::_arrow; }
+inline bool is_values (const Cell& cell) { return is_intern(cell) && get<Intern>(cell) == Intern::_values; }
 inline bool is_exit   (const Cell& cell) { return is_intern(cell) && get<Intern>(cell) == Intern::op_exit; }
 // clang-format on
 
@@ -250,7 +268,9 @@ Cell apply(Scheme& scm, const Symenv& env, T&& proc, Args&&... args)
 {
     Cons exp[3], lst[2], arg[sizeof...(args) + 1];
     Cell arg_list = pscm::list(lst, Intern::_quote, pscm::list(arg, std::forward<Args>(args)...));
-    return scm.eval(env, pscm::list(exp, Intern::_apply, std::forward<T>(proc), arg_list));
+
+    // Leave the calling C++ function by an exception during a non-local exit:
+    return scm.unwind_check(scm.eval(env, pscm::list(exp, Intern::_apply, std::forward<T>(proc), arg_list)));
 }
 
 template <typename Cell>
@@ -340,6 +360,8 @@ private:
             return "#<regex>";
         else if constexpr (std::is_same_v<T, MapPtr>)
             return "#<dict>";
+        else if constexpr (std::is_same_v<T, RecordPtr>)
+            return "#<record>";
         else if constexpr (std::is_same_v<T, VectorPtr>)
             return "#<vector>";
         else if constexpr (std::is_same_v<T, FunctionPtr>)
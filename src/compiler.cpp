@@ -0,0 +1,351 @@
+/********************************************************************************/ /**
+ * @file compiler.cpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#include <algorithm>
+
+#include "compiler.hpp"
+#include "primop.hpp"
+#include "scheme.hpp"
+
+namespace pscm {
+
+//! Compilation state of a procedure body.
+struct Compiler::Context {
+    Scheme& scm;
+    const Procedure& proc; //!< Compiled procedure.
+    const Kernel* kernel; //!< Kernel of the compiled procedure, called by recursive calls.
+    const Symenv* top; //!< Top environment of the interpreter.
+    std::vector<Symbol> deps; //!< Global operator symbols of the procedure body.
+};
+
+namespace {
+    //! Count the nesting depth of kernel calls as evaluations.
+    struct DepthGuard {
+        DepthGuard(size_t& depth) noexcept
+            : depth{ ++depth }
+        {
+        }
+        ~DepthGuard() { --depth; }
+        size_t& depth;
+    };
+
+    //! Remove all values of a call from the value stack.
+    struct StackGuard {
+        StackGuard(std::vector<Cell>& values) noexcept
+            : values{ values }
+            , base{ values.size() }
+        {
+        }
+        ~StackGuard() { values.resize(base); }
+        std::vector<Cell>& values;
+        size_t base; //!< Value stack index of the first argument value.
+    };
+}
+
+Compiler::Compiler(std::pmr::memory_resource* mres)
+    : deps{ mres }
+{
+}
+
+void Compiler::enable(bool on)
+{
+    if (is_enabled != on)
+        invalidate();
+
+    is_enabled = on;
+}
+
+void Compiler::invalidate()
+{
+    ++count;
+    deps.clear();
+}
+
+std::shared_ptr<Kernel> Compiler::compile(Scheme& scm, const Procedure& proc)
+{
+    SymenvPtr top = scm.getenv();
+    Cell code = proc.code(), iter = proc.args();
+
+    // Bindings of the environment of another interpreter might change unnoticed:
+    if (top->parent() || !is_pair(code) || !is_nil(cdr(code)))
+        return nullptr;
+
+    auto kernel = scm.make_shared<Kernel>();
+
+    for (/* */; is_pair(iter); iter = cdr(iter))
+        if (++kernel->argc > max_argc)
+            return nullptr;
+
+    if (!is_nil(iter))
+        return nullptr;
+
+    Context ctx{ scm, proc, kernel.get(), top.get(), {} };
+    bool ok = expression(ctx, kernel->body, scm.optimizer.original(code), true);
+
+    // Also a failed compilation is repeated after a redefinition of its operators:
+    deps.insert(ctx.deps.begin(), ctx.deps.end());
+
+    return ok ? kernel : nullptr;
+}
+
+//! Compile an expression into a kernel node.
+bool Compiler::expression(Context& ctx, Node& node, const Cell& expr, bool is_tail)
+{
+    if (is_symbol(expr)) {
+        node.kind = Node::Kind::param;
+        node.index = 0;
+
+        for (Cell iter = ctx.proc.args(); is_pair(iter); iter = cdr(iter), ++node.index)
+            if (get<Symbol>(car(iter)) == get<Symbol>(expr))
+                return true;
+
+        return false; // global variable
+    }
+    if (is_pair(expr))
+        return combination(ctx, node, expr, is_tail);
+
+    node.kind = Node::Kind::constant;
+    node.value = expr;
+    return is_number(expr) || is_bool(expr) || is_char(expr) || is_string(expr);
+}
+
+//! Compile a syntax form or a function call into a kernel node.
+bool Compiler::combination(Context& ctx, Node& node, const Cell& expr, bool is_tail)
+{
+    Cell op = ctx.scm.optimizer.original(expr);
+
+    if (!is_symbol(op))
+        return false; // computed operator
+
+    if (std::find(ctx.deps.begin(), ctx.deps.end(), get<Symbol>(op)) == ctx.deps.end())
+        ctx.deps.push_back(get<Symbol>(op));
+
+    const Cell* val = ctx.top->find(get<Symbol>(op));
+
+    for (Cell iter = ctx.proc.args(); val && is_pair(iter); iter = cdr(iter))
+        if (car(iter) == op)
+            val = nullptr; // formal parameter
+
+    if (!val)
+        return false;
+
+    std::vector<Cell> args;
+    Cell iter = cdr(expr);
+
+    for (/* */; is_pair(iter); iter = cdr(iter))
+        args.push_back(ctx.scm.optimizer.original(iter));
+
+    if (!is_nil(iter))
+        return false;
+
+    node.args.resize(args.size());
+
+    if (is_proc(*val)) {
+        const Procedure& proc = get<Procedure>(*val);
+        node.kind = is_tail ? Node::Kind::tail_call : Node::Kind::call;
+        node.kernel = proc == ctx.proc ? ctx.kernel : proc.kernel(ctx.scm);
+
+        if (proc.is_macro() || !node.kernel || node.kernel->argc != args.size())
+            return false;
+
+        for (size_t i = 0; i < args.size(); ++i)
+            if (!expression(ctx, node.args[i], args[i], false))
+                return false;
+
+        return true;
+    }
+    if (!is_intern(*val))
+        return false;
+
+    switch (node.opcode = get<Intern>(*val)) {
+    case Intern::_quote: // constant atom
+        node.kind = Node::Kind::constant;
+        return args.size() == 1 && !is_pair(node.value = args[0]);
+
+    case Intern::_if:
+        node.kind = Node::Kind::branch;
+
+        return (args.size() == 2 || args.size() == 3)
+            && expression(ctx, node.args[0], args[0], false)
+            && expression(ctx, node.args[1], args[1], is_tail)
+            && (args.size() == 2 || expression(ctx, node.args[2], args[2], is_tail));
+
+    case Intern::_and:
+    case Intern::_or:
+        node.kind = node.opcode == Intern::_and ? Node::Kind::conjunction : Node::Kind::disjunction;
+
+        for (size_t i = 0; i < args.size(); ++i)
+            if (!expression(ctx, node.args[i], args[i], is_tail && i + 1 == args.size()))
+                return false;
+
+        return true;
+
+    default:
+        if (node.opcode < Intern::op_eq
+            || !(is_pure_primop(node.opcode) || node.opcode == Intern::op_vecref || node.opcode == Intern::op_veclen))
+            return false;
+
+        node.kind = Node::Kind::primop;
+
+        for (size_t i = 0; i < args.size(); ++i)
+            if (!expression(ctx, node.args[i], args[i], false))
+                return false;
+
+        return true;
+    }
+}
+
+bool Compiler::call(Scheme& scm, const Kernel& kernel, const SymenvPtr& env, Cell args, Cell& result)
+{
+    Cell argv[max_argc];
+    size_t argc = 0;
+
+    for (Cell iter = args; is_pair(iter); iter = cdr(iter))
+        if (++argc > kernel.argc)
+            return false;
+
+    if (argc != kernel.argc)
+        return false; // report the error by the interpreter
+
+    // The argument evaluation might switch to another coroutine, which calls kernels itself:
+    for (argc = 0; is_pair(args); args = cdr(args))
+        argv[argc++] = scm.eval_value(env, car(args));
+
+    if (scm.is_unwinding())
+        result = none;
+    else {
+        StackGuard guard{ values };
+        values.insert(values.end(), argv, argv + argc);
+        result = run(scm, &kernel, guard.base, env, 0);
+    }
+    return true;
+}
+
+/**
+ * Evaluate a kernel body and all calls in its tail position.
+ *
+ * @param base Value stack index of the first formal parameter value.
+ */
+Cell Compiler::run(Scheme& scm, const Kernel* kernel, size_t base, const SymenvPtr& env, size_t level)
+{
+    for (;;) {
+        const Kernel* tail = nullptr;
+        Cell val = eval(scm, kernel->body, base, env, level, tail);
+
+        if (!tail)
+            return val;
+
+        // Replace the formal parameter values by the argument values of the tail call:
+        std::move(values.end() - tail->argc, values.end(), values.begin() + base);
+        values.resize(base + tail->argc);
+        kernel = tail;
+    }
+}
+
+/**
+ * Evaluate a kernel node.
+ *
+ * @param base  Value stack index of the first formal parameter value.
+ * @param level Nesting level of primary function calls.
+ * @param tail  Kernel of a pending call in tail position, set by a tail_call node.
+ */
+Cell Compiler::eval(Scheme& scm, const Node& node, size_t base, const SymenvPtr& env, size_t level, const Kernel*& tail)
+{
+    switch (node.kind) {
+    case Node::Kind::constant:
+        return node.value;
+
+    case Node::Kind::param:
+        return values[base + node.index];
+
+    case Node::Kind::branch:
+        if (is_true(eval(scm, node.args[0], base, env, level, tail)))
+            return eval(scm, node.args[1], base, env, level, tail);
+
+        return node.args.size() > 2 ? eval(scm, node.args[2], base, env, level, tail) : none;
+
+    case Node::Kind::conjunction: {
+        Cell val = true;
+
+        for (const Node& arg : node.args)
+            if (is_false(val = eval(scm, arg, base, env, level, tail)))
+                break;
+
+        return val;
+    }
+    case Node::Kind::disjunction: {
+        Cell val = false;
+
+        for (const Node& arg : node.args)
+            if (is_true(val = eval(scm, arg, base, env, level, tail)))
+                break;
+
+        return val;
+    }
+    case Node::Kind::primop:
+        return primop(scm, node, base, env, level, tail);
+
+    case Node::Kind::call: {
+        StackGuard guard{ values };
+
+        for (const Node& arg : node.args) {
+            Cell val = eval(scm, arg, base, env, level, tail);
+            values.push_back(val);
+        }
+        if (!--scm.ticks)
+            scm.preempt();
+
+        scm.check_depth();
+        DepthGuard depth{ scm.eval_depth };
+        return run(scm, node.kernel, guard.base, env, level);
+    }
+    case Node::Kind::tail_call:
+        for (const Node& arg : node.args) {
+            Cell val = eval(scm, arg, base, env, level, tail);
+            values.push_back(val);
+        }
+        if (!--scm.ticks)
+            scm.preempt();
+
+        tail = node.kernel;
+        return none;
+    }
+    return none;
+}
+
+//! Call a primary function, a binary arithmetic operation or comparison inline if possible.
+Cell Compiler::primop(Scheme& scm, const Node& node, size_t base, const SymenvPtr& env, size_t level, const Kernel*& tail)
+{
+    scm.check_depth();
+    DepthGuard depth{ scm.eval_depth };
+
+    if (stack.size() <= level)
+        stack.resize(level + 1);
+
+    if (node.args.size() == 2) {
+        Cell lhs = eval(scm, node.args[0], base, env, level + 1, tail),
+             rhs = eval(scm, node.args[1], base, env, level + 1, tail);
+
+        if (Cell val = none; call_arithmetic(node.opcode, lhs, rhs, val))
+            return val;
+
+        stack[level].assign({ lhs, rhs });
+    } else {
+        stack[level].clear();
+
+        for (const Node& arg : node.args) {
+            Cell val = eval(scm, arg, base, env, level + 1, tail);
+            stack[level].push_back(val);
+        }
+    }
+    Cell val = pscm::call(scm, env, node.opcode, stack[level]);
+    stack[level].clear();
+    return val;
+}
+
+} // namespace pscm
@@ -0,0 +1,141 @@
+/********************************************************************************/ /**
+ * @file compiler.hpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#ifndef COMPILER_HPP
+#define COMPILER_HPP
+
+#include <deque>
+#include <memory_resource>
+#include <unordered_set>
+#include <vector>
+
+#include "cell.hpp"
+
+namespace pscm {
+
+class Scheme;
+
+struct Kernel;
+
+/**
+ * Node of a compiled procedure body.
+ */
+struct Node {
+    enum class Kind {
+        constant,
+        param, //!< Formal parameter reference.
+        branch, //!< if syntax
+        conjunction, //!< and syntax
+        disjunction, //!< or syntax
+        primop, //!< Primary function call.
+        call, //!< Compiled procedure call.
+        tail_call //!< Compiled procedure call in tail position.
+    };
+    Kind kind = Kind::constant;
+    Intern opcode = Intern::op_eq;
+    size_t index = 0; //!< Index of a formal parameter.
+    Cell value = none; //!< Value of a constant.
+    const Kernel* kernel = nullptr; //!< Kernel of a called procedure.
+    std::vector<Node> args;
+};
+
+/**
+ * Compiled procedure.
+ */
+struct Kernel {
+    size_t argc = 0; //!< Number of formal parameters.
+    Node body;
+};
+
+/**
+ * Optional compiler of numeric procedures into kernels.
+ *
+ * A closed leaf procedure of the top environment with a proper formal parameter list
+ * of at most max_argc symbols and a single body expression is compiled into a tree of
+ * kernel nodes, if its body expression only consists of:
+ *
+ * - Constants and references of the formal parameters.
+ * - The syntax forms if, and, or and quote.
+ * - Calls of pure primary functions, vector-ref and vector-length.
+ * - Calls of the procedure itself or of other compiled procedures.
+ *
+ * A kernel is evaluated without symbol lookups, call frame environments and argument
+ * vector allocations. Calls in tail position don't grow the value stack. A kernel
+ * isn't native machine code, but is evaluated by the tree walking kernel interpreter
+ * of this class, which runs on every target. It only saves the interpretive overhead
+ * of the evaluator: a host build runs test/ray.scm about 1.2 times faster. Binary
+ * arithmetic operations and comparisons of two floating point numbers are evaluated
+ * inline. If this type guard fails, the operation falls back to the primary function
+ * of the interpreter, so that a kernel returns the same results and throws the same
+ * exceptions as the interpreted procedure.
+ *
+ * A kernel depends on the global bindings of all its operator symbols. Any redefinition
+ * or assignment of such a symbol invalidates all kernels, which are recompiled at
+ * their next call.
+ */
+class Compiler {
+public:
+    static constexpr size_t max_argc = 8; //!< Maximal number of formal parameters of a compiled procedure.
+
+    explicit Compiler(std::pmr::memory_resource* mres = std::pmr::get_default_resource());
+
+    bool enabled() const noexcept { return is_enabled; } //!< Return true, if the compiler is enabled.
+
+    //! Enable or disable the compiler. Disabling invalidates all kernels.
+    void enable(bool on);
+
+    //! Return the compilation epoch, which is incremented, whenever all kernels become invalid.
+    size_t epoch() const noexcept { return count; }
+
+    //! Invalidate all kernels, if any kernel depends on the global binding of argument symbol.
+    void invalidate(const Symbol& sym)
+    {
+        if (!deps.empty() && deps.count(sym))
+            invalidate();
+    }
+
+    //! Invalidate all kernels.
+    void invalidate();
+
+    /**
+     * Compile a procedure into a new kernel.
+     * @return Kernel or null-pointer, if the procedure can't be compiled.
+     */
+    std::shared_ptr<Kernel> compile(Scheme& scm, const Procedure& proc);
+
+    /**
+     * Call a kernel with the arguments of a procedure call expression.
+     *
+     * @param env         Environment, where to evaluate the argument expressions.
+     * @param args        Argument expression list.
+     * @param[out] result Result of the call.
+     * @return False, if the number of arguments doesn't match the kernel, to let the
+     *         interpreter report the error.
+     */
+    bool call(Scheme& scm, const Kernel& kernel, const SymenvPtr& env, Cell args, Cell& result);
+
+private:
+    struct Context;
+
+    bool expression(Context& ctx, Node& node, const Cell& expr, bool is_tail);
+    bool combination(Context& ctx, Node& node, const Cell& expr, bool is_tail);
+
+    Cell run(Scheme& scm, const Kernel* kernel, size_t base, const SymenvPtr& env, size_t level);
+    Cell eval(Scheme& scm, const Node& node, size_t base, const SymenvPtr& env, size_t level, const Kernel*& tail);
+    Cell primop(Scheme& scm, const Node& node, size_t base, const SymenvPtr& env, size_t level, const Kernel*& tail);
+
+    std::pmr::unordered_set<Symbol, Symbol::hash> deps; //!< Global symbols of all valid kernels.
+    std::vector<Cell> values; //!< Value stack of the formal parameters of all active kernel calls.
+    std::deque<std::vector<Cell>> stack; //!< Reused argument vectors of primary function calls by nesting level.
+    size_t count = 1;
+    bool is_enabled = false;
+};
+
+} // namespace pscm
+
+#endif // COMPILER_HPP
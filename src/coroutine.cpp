@@ -0,0 +1,685 @@
+/********************************************************************************/ /**
+ * @file coroutine.cpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#include <algorithm>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "coroutine.hpp"
+#include "scheme.hpp"
+
+namespace pscm {
+
+Coroutine::Coroutine(Scheme& scm, const SymenvPtr& senv, const Cell& proc)
+    : scm{ scm }
+    , senv{ senv }
+    , proc{ proc }
+    , frames{ scm.memory_resource() }
+    , values{ scm.memory_resource() }
+{
+    scm.coroutines.push_back(this);
+}
+
+Coroutine::~Coroutine()
+{
+    scm.coroutines.erase(std::find(scm.coroutines.begin(), scm.coroutines.end(), this));
+}
+
+void Coroutine::close()
+{
+    state != State::running || (void(throw std::invalid_argument("close-coroutine - coroutine is running")), 0);
+
+    if (state != State::done)
+        finish();
+}
+
+//! Drop the evaluator state of a finished coroutine.
+void Coroutine::finish() noexcept
+{
+    state = State::done;
+    transfer = none;
+    env = nullptr;
+    expr = val = none;
+    frames.clear();
+    values.clear();
+}
+
+Cell Coroutine::resume(const Cell& arg)
+{
+    if (state == State::done)
+        return static_cast<Char>(EOF);
+
+    state != State::running || (void(throw std::invalid_argument("coroutine - already running")), 0);
+
+    if (state == State::created) { // evaluate the call expression (proc)
+        env = senv;
+        expr = scm.cons(proc, nil);
+        is_eval = true;
+    } else if (!is_eval)
+        val = arg;
+
+    state = State::running;
+    Coroutine* outer = std::exchange(scm.coroutine, this);
+    bool is_suspended;
+    try {
+        is_suspended = run();
+    } catch (...) {
+        scm.coroutine = outer;
+        finish();
+        throw;
+    }
+    scm.coroutine = outer;
+
+    if (is_suspended) {
+        state = State::suspended;
+        return std::exchange(transfer, none);
+    }
+    Cell result = scm.is_unwinding() ? none : val;
+    finish();
+    return result;
+}
+
+void Coroutine::push(Frame::Kind kind, const Cell& expr, const Cell& proc, size_t base, bool is_apply)
+{
+    const size_t limit = std::min(scm.max_depth, max_frames);
+    frames.size() < limit || (void(throw depth_exceeded{ limit }), 0);
+    frames.push_back({ kind, is_apply, base, env, expr, proc });
+}
+
+//! Evaluate the body expression list in tail position.
+void Coroutine::body(const Cell& code)
+{
+    if (!is_pair(code)) {
+        val = none;
+        is_eval = false;
+        return;
+    }
+    if (is_pair(cdr(code)))
+        push(Frame::Kind::body, cdr(code));
+
+    expr = car(code);
+    is_eval = true;
+}
+
+/**
+ * Evaluate until the coroutine procedure has finished or is suspended.
+ * @return True, if the coroutine is suspended.
+ */
+bool Coroutine::run()
+{
+    for (;;) {
+        if (scm.is_unwinding()) // a non-local exit leaves the coroutine procedure
+            return false;
+
+        if (is_eval) {
+            if (is_symbol(expr)) {
+                val = env->get(get<Symbol>(expr));
+                is_eval = false;
+
+            } else if (!is_pair(expr)) {
+                val = expr;
+                is_eval = false;
+
+            } else {
+                if (!--scm.ticks) { // a green thread passes the control at the end of each fuel slice
+                    scm.preempt();
+
+                    if (scm.scheduler.is_current(this))
+                        return true;
+                }
+
+                if (!is_symbol(car(expr))) {
+                    push(Frame::Kind::operand, expr);
+                    expr = car(expr);
+
+                } else if (dispatch(env->get(get<Symbol>(car(expr))), false))
+                    return true;
+            }
+            continue;
+        }
+        if (frames.empty())
+            return false;
+
+        Frame& frame = frames.back();
+        env = frame.env;
+
+        switch (frame.kind) {
+        case Frame::Kind::operand: {
+            bool is_apply = frame.is_apply;
+            expr = frame.expr;
+            frames.pop_back();
+
+            if (dispatch(val, is_apply))
+                return true;
+            break;
+        }
+        case Frame::Kind::argument:
+            if (is_values(val))
+                val = scm.raise_values(car(frame.expr));
+
+            values.push_back(val);
+
+            if (is_pair(frame.expr = cdr(frame.expr))) {
+                expr = car(frame.expr);
+                is_eval = true;
+            } else {
+                Cell proc = frame.proc;
+                size_t base = frame.base;
+                bool is_apply = frame.is_apply;
+                frames.pop_back();
+
+                if (invoke(proc, base, is_apply))
+                    return true;
+            }
+            break;
+
+        case Frame::Kind::body:
+            expr = car(frame.expr);
+            is_eval = true;
+
+            if (!is_pair(frame.expr = cdr(frame.expr)))
+                frames.pop_back(); // evaluate the last expression in tail position
+            break;
+
+        case Frame::Kind::test: {
+            Cell args = frame.expr;
+            frames.pop_back();
+
+            if (is_values(val))
+                val = scm.raise_values(car(args));
+
+            if (is_true(val)) {
+                expr = cadr(args);
+                is_eval = true;
+            } else if (is_pair(cddr(args))) {
+                expr = car(cddr(args));
+                is_eval = true;
+            } else
+                val = none;
+            break;
+        }
+        case Frame::Kind::when:
+        case Frame::Kind::unless: {
+            Cell args = frame.expr;
+            bool is_when = frame.kind == Frame::Kind::when;
+            frames.pop_back();
+
+            if (is_values(val))
+                val = scm.raise_values(car(args));
+
+            if (is_true(val) == is_when)
+                body(cdr(args));
+            else
+                val = none;
+            break;
+        }
+        case Frame::Kind::cond: {
+            Cell clause = car(frame.expr);
+
+            if (is_values(val))
+                val = scm.raise_values(car(clause));
+
+            if (is_false(val)) {
+                if (is_pair(frame.expr = cdr(frame.expr))) {
+                    is_pair(car(frame.expr)) || (void(throw std::invalid_argument("invalid cond syntax")), 0);
+                    expr = caar(frame.expr);
+                    is_eval = true;
+                } else {
+                    frames.pop_back();
+                    val = none;
+                }
+                break;
+            }
+            frames.pop_back();
+            Cell code = cdr(clause);
+
+            if (is_nil(code)) // clause: (<test>)
+                break;
+
+            // Lookup a symbol only, since evaluating the first expression might have side effects:
+            const Cell* first = &car(code);
+
+            if (is_symbol(*first))
+                first = env->find(get<Symbol>(*first));
+
+            if (!first || !is_arrow(*first)) {
+                body(code);
+                break;
+            }
+            // clause: (<test> => <receiver>)
+            if (is_else(val) || !is_pair(cdr(code)))
+                throw std::invalid_argument("invalid cond syntax");
+
+            push(Frame::Kind::receiver, cdr(code), val);
+            expr = cadr(code);
+            is_eval = true;
+            break;
+        }
+        case Frame::Kind::receiver: {
+            Cell test = frame.proc;
+
+            if (is_pair(frame.expr = cdr(frame.expr))) { // only the last receiver is called in tail position
+                pscm::apply(scm, env, val, test);
+                expr = car(frame.expr);
+                is_eval = true;
+                break;
+            }
+            frames.pop_back();
+            Cell receiver = val;
+            size_t base = values.size();
+            values.push_back(test);
+
+            if (invoke(receiver, base, false))
+                return true;
+            break;
+        }
+        case Frame::Kind::and_:
+        case Frame::Kind::or_:
+            if (is_values(val))
+                val = scm.raise_values(car(frame.expr));
+
+            if (is_false(val) == (frame.kind == Frame::Kind::and_)) {
+                frames.pop_back();
+                break;
+            }
+            frame.expr = cdr(frame.expr);
+            expr = car(frame.expr);
+            is_eval = true;
+
+            if (!is_pair(cdr(frame.expr)))
+                frames.pop_back(); // evaluate the last expression in tail position
+            break;
+
+        case Frame::Kind::define:
+        case Frame::Kind::assign: {
+            const Symbol& sym = get<Symbol>(car(frame.expr));
+
+            if (is_values(val))
+                val = scm.raise_values(cadr(frame.expr));
+
+            if (frame.kind == Frame::Kind::define)
+                env->add(sym, val);
+            else
+                env->set(sym, val);
+
+            if (frame.kind == Frame::Kind::assign || env == scm.topenv)
+                scm.deoptimize(sym);
+
+            frames.pop_back();
+            val = none;
+            break;
+        }
+        case Frame::Kind::receive: {
+            Cell args = frame.expr;
+            frames.pop_back();
+
+            env = scm.newenv(env);
+            scm.bind_values(env, car(args), val);
+            body(cddr(args));
+            break;
+        }
+        case Frame::Kind::message: {
+            auto& chan = *get<FunctionPtr>(frame.proc)->target<Scheduler::Endpoint>()->channel;
+
+            if (chan.messages.empty()) {
+                scm.scheduler.wait(chan);
+                return true;
+            }
+            frames.pop_back();
+            val = chan.messages.front();
+            chan.messages.pop_front();
+            break;
+        }
+        }
+    }
+}
+
+/**
+ * Evaluate the call or syntax form in register expr of the operator value.
+ *
+ * This evaluator deliberately differs from Scheme::eval: It doesn't check the native
+ * stack depth by Scheme::check_depth, doesn't run compiled numeric kernels, doesn't take
+ * the binary arithmetic fast path and doesn't reuse the rest parameter cons-cells of leaf
+ * procedures. It implements the syntax forms if, cond, and, or, when, unless, define,
+ * set!, receive, apply and quasiquote on its own, so that each semantic change of these
+ * forms in Scheme::eval must be made here as well.
+ *
+ * @return True, if the coroutine is suspended.
+ */
+bool Coroutine::dispatch(Cell proc, bool is_apply)
+{
+    Cell args = is_apply ? cddr(expr) : cdr(expr);
+
+    if (is_proc(proc) && is_macro(proc)) {
+        if (is_apply) {
+            val = scm.eval(env, expr);
+            is_eval = false;
+        } else
+            expr = scm.expand(env, proc, expr);
+
+        return false;
+    }
+    if (is_proc(proc) || is_func(proc) || is_apply)
+        return call(proc, args, is_apply);
+
+    is_intern(proc) || (void(throw std::invalid_argument("invalid procedure")), 0);
+
+    switch (get<Intern>(proc)) {
+    case Intern::_quote:
+        val = car(args);
+        break;
+
+    case Intern::_lambda:
+        val = scm.closure(env, args, car(args));
+        break;
+
+    case Intern::_define:
+        if (!is_pair(car(args))) {
+            push(Frame::Kind::define, args);
+            expr = cadr(args);
+            return false;
+        }
+        env->add(get<Symbol>(caar(args)), scm.closure(env, args, cdar(args)));
+
+        if (env == scm.topenv)
+            scm.deoptimize(get<Symbol>(caar(args)));
+        val = none;
+        break;
+
+    case Intern::_setb:
+        push(Frame::Kind::assign, args);
+        expr = cadr(args);
+        return false;
+
+    case Intern::_apply:
+        push(Frame::Kind::operand, expr, none, 0, true);
+        expr = car(args);
+        return false;
+
+    case Intern::_begin:
+        body(args);
+        return false;
+
+    case Intern::_if:
+        push(Frame::Kind::test, args);
+        expr = car(args);
+        return false;
+
+    case Intern::_when:
+    case Intern::_unless:
+        push(get<Intern>(proc) == Intern::_when ? Frame::Kind::when : Frame::Kind::unless, args);
+        expr = car(args);
+        return false;
+
+    case Intern::_cond:
+        if (!is_pair(args)) {
+            val = none;
+            break;
+        }
+        is_pair(car(args)) || (void(throw std::invalid_argument("invalid cond syntax")), 0);
+        push(Frame::Kind::cond, args);
+        expr = caar(args);
+        return false;
+
+    case Intern::_and:
+    case Intern::_or:
+        if (!is_pair(args)) {
+            val = get<Intern>(proc) == Intern::_and;
+            break;
+        }
+        if (is_pair(cdr(args)))
+            push(get<Intern>(proc) == Intern::_and ? Frame::Kind::and_ : Frame::Kind::or_, args);
+
+        expr = car(args);
+        return false;
+
+    case Intern::_receive:
+        push(Frame::Kind::receive, args);
+        expr = cadr(args);
+        return false;
+
+    case Intern::_quasiquote:
+        expr = scm.syntax_quasiquote(expr);
+        return false;
+
+    case Intern::_macro:
+    case Intern::_define_syntax:
+    case Intern::_define_record_type:
+    case Intern::_syntax_rules:
+    case Intern::_let_values:
+        val = scm.eval(env, expr);
+        break;
+
+    default: // primary function
+        return call(proc, args, false);
+    }
+    is_eval = false;
+    return false;
+}
+
+/**
+ * Suspend the running green thread of this coroutine, if it calls sleep or waits for
+ * a message of an empty channel.
+ * @return True, if the green thread is suspended.
+ */
+bool Coroutine::suspend(const Cell& proc, size_t base)
+{
+    size_t argc = values.size() - base;
+    Cell chan = none;
+
+    if (is_intern(proc))
+        switch (get<Intern>(proc)) {
+        case Intern::op_sleep: {
+            argc == 1 || (void(throw std::invalid_argument("sleep - invalid number of arguments")), 0);
+            Int ms = get<Int>(get<Number>(values[base]));
+            ms >= 0 || (void(throw std::invalid_argument("sleep - negative duration")), 0);
+
+            scm.scheduler.wait(std::chrono::milliseconds{ ms });
+            values.resize(base);
+            val = none;
+            is_eval = false;
+            return true;
+        }
+        case Intern::op_channel_receive:
+            if (argc == 1)
+                chan = values[base];
+            break;
+
+        default:
+            break;
+        }
+    else if (is_func(proc) && !argc)
+        chan = proc;
+
+    const Scheduler::Endpoint* endpoint = is_func(chan) ? get<FunctionPtr>(chan)->target<Scheduler::Endpoint>() : nullptr;
+
+    if (!endpoint || !endpoint->channel->messages.empty())
+        return false;
+
+    scm.scheduler.wait(*endpoint->channel);
+    values.resize(base);
+    push(Frame::Kind::message, none, chan);
+    is_eval = false;
+    return true;
+}
+
+//! Evaluate the argument expressions of a call and invoke the operator.
+bool Coroutine::call(const Cell& proc, const Cell& args, bool is_apply)
+{
+    size_t base = values.size();
+
+    if (!is_pair(args))
+        return invoke(proc, base, is_apply);
+
+    push(Frame::Kind::argument, args, proc, base, is_apply);
+    expr = car(args);
+    is_eval = true;
+    return false;
+}
+
+/**
+ * Call the operator with the argument values starting at base. A procedure body is
+ * evaluated by this coroutine, any other function is called by the interpreter.
+ * @return True, if the coroutine is suspended.
+ */
+bool Coroutine::invoke(const Cell& proc, size_t base, bool is_apply)
+{
+    if (is_apply) { // append the items of the last argument list
+        values.size() > base || (void(throw std::invalid_argument("apply - invalid number of arguments")), 0);
+        Cell list = values.back();
+        values.pop_back();
+
+        for (/* */; is_pair(list); list = cdr(list))
+            values.push_back(car(list));
+    }
+    if (is_proc(proc)) {
+        std::tie(env, expr) = get<Procedure>(proc).bind(scm, values.data() + base, values.size() - base);
+        values.resize(base);
+        body(expr);
+        return false;
+    }
+    if (is_intern(proc) && get<Intern>(proc) == Intern::op_yield) {
+        values.size() - base <= 1 || (void(throw std::invalid_argument("yield - too many arguments")), 0);
+        transfer = values.size() > base ? values.back() : none;
+        values.resize(base);
+        val = none;
+        is_eval = false;
+        return true;
+    }
+    if (scm.scheduler.is_current(this) && suspend(proc, base))
+        return true;
+
+    std::vector<Cell> args{ values.begin() + static_cast<std::ptrdiff_t>(base), values.end() };
+    values.resize(base);
+    val = scm.apply(env, proc, args);
+    is_eval = false;
+    return false;
+}
+
+void Scheduler::spawn(const SymenvPtr& senv, const Cell& proc)
+{
+    tasks.push_back({ scm.make_shared<Coroutine>(scm, senv, proc), clock::time_point{}, nullptr });
+}
+
+/**
+ * Resume each thread once, which doesn't sleep and doesn't wait for a message of
+ * an empty channel. Finished threads are removed.
+ * @return False, if no thread was ready.
+ */
+bool Scheduler::round()
+{
+    !scm.coroutine || (void(throw std::invalid_argument("scheduler - called by a coroutine")), 0);
+
+    auto now = clock::now();
+    bool is_ready = false;
+
+    for (current = 0; current < tasks.size(); /* */) {
+        Task& task = tasks[current];
+
+        if (task.wakeup > now || (task.channel && task.channel->messages.empty())) {
+            ++current;
+            continue;
+        }
+        std::shared_ptr<Coroutine> coroutine = task.coroutine;
+        task.channel = nullptr;
+        is_ready = true;
+        is_running = true;
+        try {
+            coroutine->resume(none);
+        } catch (...) {
+            is_running = false;
+            tasks.erase(tasks.begin() + current);
+            throw;
+        }
+        is_running = false;
+
+        // New threads are only appended, finished threads are only removed here:
+        if (coroutine->is_done())
+            tasks.erase(tasks.begin() + current);
+        else
+            ++current;
+    }
+    return is_ready;
+}
+
+//! Wait until the next sleeping thread wakes up, at most up to the deadline.
+void Scheduler::idle(clock::time_point deadline) const
+{
+    for (const Task& task : tasks)
+        if (!task.channel)
+            deadline = std::min(deadline, task.wakeup);
+
+    deadline != clock::time_point::max()
+        || (void(throw std::invalid_argument("scheduler - all threads wait for a channel message")), 0);
+
+    std::this_thread::sleep_until(deadline);
+}
+
+Cell Scheduler::yield(const Cell&)
+{
+    // A coroutine suspends at its own yield calls, but not inside of a native function call:
+    !scm.coroutine || (void(throw std::invalid_argument("yield - inside of a native call of a coroutine")), 0);
+
+    round();
+    return none;
+}
+
+void Scheduler::sleep(clock::duration duration)
+{
+    auto deadline = clock::now() + duration;
+
+    while (clock::now() < deadline)
+        if (!round())
+            tasks.empty() ? std::this_thread::sleep_until(deadline) : idle(deadline);
+}
+
+std::shared_ptr<Scheduler::Channel> Scheduler::channel()
+{
+    channels.erase(std::remove_if(channels.begin(), channels.end(),
+                       [](const std::weak_ptr<Channel>& ptr) { return ptr.expired(); }),
+        channels.end());
+
+    auto chan = scm.make_shared<Channel>();
+    channels.push_back(chan);
+    return chan;
+}
+
+Cell Scheduler::receive(Channel& chan)
+{
+    while (chan.messages.empty()) {
+        !tasks.empty() || (void(throw std::invalid_argument("channel-receive - no thread to send a message")), 0);
+
+        if (!round())
+            idle(clock::time_point::max());
+    }
+
+    Cell msg = chan.messages.front();
+    chan.messages.pop_front();
+    return msg;
+}
+
+Cell Scheduler::Endpoint::operator()(Scheme& scm, const SymenvPtr&, const std::vector<Cell>& args) const
+{
+    if (args.empty())
+        return scm.scheduler.receive(*channel);
+
+    channel->messages.push_back(args[0]);
+    return none;
+}
+
+void Scheduler::run()
+{
+    !is_running || (void(throw std::invalid_argument("run-threads - called by a green thread")), 0);
+
+    while (!tasks.empty())
+        if (!round())
+            idle(clock::time_point::max());
+}
+
+} // namespace pscm
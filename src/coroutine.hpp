@@ -0,0 +1,283 @@
+/********************************************************************************/ /**
+ * @file coroutine.hpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#ifndef COROUTINE_HPP
+#define COROUTINE_HPP
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+#include "cell.hpp"
+
+namespace pscm {
+
+class Scheme;
+
+/**
+ * Resumable coroutine of a scheme procedure without arguments.
+ *
+ * @verbatim
+ * (define gen (make-coroutine (lambda () (yield 1) (yield 2) 'done)))
+ * (gen) => 1
+ * (gen) => 2
+ * (gen) => done
+ * (gen) => #<eof>
+ * (close-coroutine gen)
+ * @endverbatim
+ *
+ * Each resume call continues the procedure up to its next yield call or up to
+ * its end. The value of a resume call is returned by the pending yield call and
+ * vice versa. The value of the procedure is returned by the last resume call, any
+ * further resume call returns the eof-object.
+ *
+ * The recursive evaluator of the interpreter keeps its state on the native stack
+ * and isn't able to suspend an evaluation. Therefore a coroutine evaluates its
+ * procedure by an evaluator of its own, which keeps the pending expressions,
+ * call frames and argument values on an explicit stack instead. This evaluator
+ * handles the procedure calls and the control syntax forms itself, so that
+ * a yield call might suspend it at any nesting depth of procedure calls. All
+ * other syntax forms and the primary and external functions are evaluated by
+ * the interpreter on the native stack of the resume call. A yield call inside
+ * of such a native call, as by a procedure argument of for-each, fails with an
+ * error. Suspending a coroutine only saves the registers of its evaluator, so
+ * that all coroutines are evaluated by the task of the interpreter.
+ *
+ * A non-local exit or an error inside of the coroutine procedure finishes the
+ * coroutine and continues at the resume call. The explicit stack of each coroutine
+ * is bounded by the nesting depth limit of the interpreter and by max_frames, which
+ * is PLATFORM_COROUTINE_FRAMES, and its memory is accounted by the memory budget.
+ *
+ * The garbage collector marks the procedure, the registers and the explicit
+ * stack of each coroutine, so that unreachable cons-cells are also released,
+ * while a coroutine is suspended. A coroutine, which isn't needed anymore, can
+ * be finished explicitly by close().
+ */
+class Coroutine {
+public:
+    Coroutine(Scheme& scm, const SymenvPtr& senv, const Cell& proc);
+    ~Coroutine();
+
+    //! Maximum number of frames of the explicit stack.
+    static constexpr size_t max_frames = PLATFORM_COROUTINE_FRAMES;
+
+    Coroutine(const Coroutine&) = delete;
+    Coroutine& operator=(const Coroutine&) = delete;
+
+    //! Function object of a coroutine, which is called by scheme to resume the coroutine.
+    struct Resume {
+        std::shared_ptr<Coroutine> coroutine;
+
+        Cell operator()(Scheme&, const SymenvPtr&, const std::vector<Cell>& args) const
+        {
+            return coroutine->resume(args.empty() ? none : args[0]);
+        }
+    };
+
+    //! Continue the coroutine procedure with argument value as result of its pending
+    //! yield call and return the value of its next yield call or of its end.
+    Cell resume(const Cell& val);
+
+    //! Finish the coroutine without resuming it and drop its suspended evaluation.
+    void close();
+
+    //! Return true, if the coroutine procedure has finished.
+    bool is_done() const noexcept { return state == State::done; }
+
+    //! Call function for each cell, which the coroutine holds.
+    template <typename Fun>
+    void for_each_cell(Fun&& fun) const
+    {
+        if (senv)
+            fun(Cell{ senv });
+        fun(proc);
+        fun(transfer);
+
+        if (env)
+            fun(Cell{ env });
+        fun(expr);
+        fun(val);
+
+        for (const Frame& frame : frames) {
+            fun(Cell{ frame.env });
+            fun(frame.expr);
+            fun(frame.proc);
+        }
+        for (const Cell& cell : values)
+            fun(cell);
+    }
+
+private:
+    enum class State {
+        created, //!< Procedure not started yet.
+        running,
+        suspended, //!< Waiting in a yield call.
+        done //!< Procedure finished.
+    };
+
+    //! Pending evaluation of the explicit stack, which continues with the value of its last subexpression.
+    struct Frame {
+        enum class Kind : unsigned char {
+            operand, //!< Call expression expr, which waits for its operator value.
+            argument, //!< Argument expression list expr of operator proc, argument values start at base.
+            body, //!< Remaining body expressions expr.
+            test, //!< Argument list expr of an if expression.
+            when, //!< Argument list expr of a when expression.
+            unless, //!< Argument list expr of an unless expression.
+            cond, //!< Clause list expr of a cond expression, whose first test is evaluated.
+            receiver, //!< Receiver expressions expr of a (test => receiver) clause with test value proc.
+            and_, //!< Expression list expr of an and expression, whose first expression is evaluated.
+            or_, //!< Expression list expr of an or expression, whose first expression is evaluated.
+            define, //!< Argument list expr of a define expression.
+            assign, //!< Argument list expr of a set! expression.
+            receive, //!< Argument list expr of a receive expression.
+            message //!< Channel function proc of a green thread, which waits for a message.
+        };
+        Kind kind;
+        bool is_apply; //!< True, if the last argument value is a list of further arguments.
+        size_t base;
+        SymenvPtr env;
+        Cell expr;
+        Cell proc;
+    };
+    bool run();
+    bool dispatch(Cell proc, bool is_apply);
+    bool call(const Cell& proc, const Cell& args, bool is_apply);
+    bool invoke(const Cell& proc, size_t base, bool is_apply);
+    bool suspend(const Cell& proc, size_t base);
+    void body(const Cell& code);
+    void push(Frame::Kind kind, const Cell& expr, const Cell& proc = none, size_t base = 0, bool is_apply = false);
+    void finish() noexcept;
+
+    Scheme& scm;
+    SymenvPtr senv;
+    Cell proc;
+    Cell transfer = none; //!< Value passed between resume and yield.
+    State state = State::created;
+
+    // Registers of the evaluator, which evaluates expr at env, if is_eval is true,
+    // and continues the top frame with value val otherwise:
+    SymenvPtr env;
+    Cell expr = none;
+    Cell val = none;
+    bool is_eval = false;
+
+    std::pmr::vector<Frame> frames; //!< Explicit stack of pending evaluations.
+    std::pmr::vector<Cell> values; //!< Argument values of pending procedure calls.
+};
+
+/**
+ * Cooperative scheduler of the green threads of an interpreter.
+ *
+ * @verbatim
+ * (spawn <thunk>)             start a new green thread
+ * (yield)                     pass the control to the next ready thread
+ * (sleep <ms>)                suspend the current thread for a number of milliseconds
+ * (make-channel)              return a new unbounded message channel
+ * (channel-send <chan> <obj>) append a message to a channel
+ * (channel-receive <chan>)    remove the first message of a channel, wait while it is empty
+ * (run-threads)               run all threads until they are finished
+ * @endverbatim
+ *
+ * Each green thread is a ::Coroutine, which is resumed in a round robin order by the
+ * main evaluation, whenever it yields, sleeps or waits for a channel message, and
+ * at the end of each fuel slice of the interpreter. All threads share the environment,
+ * the cons-cell store and the symbol table of the interpreter and are evaluated by
+ * its task. A suspended thread only costs the explicit stack of its coroutine, which
+ * the garbage collector marks.
+ *
+ * The main evaluation waits for a channel message or for a sleep duration by
+ * resuming the ready threads. Called inside of a native function call of a green
+ * thread, as by a procedure argument of for-each, sleep and an empty channel fail
+ * with an error.
+ */
+class Scheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    //! Message channel of the green threads.
+    struct Channel {
+        std::deque<Cell> messages;
+    };
+
+    //! Function object of a channel, which is called by scheme to receive a
+    //! message without argument or to send its argument otherwise.
+    struct Endpoint {
+        std::shared_ptr<Channel> channel;
+
+        Cell operator()(Scheme& scm, const SymenvPtr&, const std::vector<Cell>& args) const;
+    };
+
+    explicit Scheduler(Scheme& scm)
+        : scm{ scm }
+    {
+    }
+
+    //! Start a new green thread of a procedure without arguments.
+    void spawn(const SymenvPtr& senv, const Cell& proc);
+
+    //! Pass the control to the scheduler, if called by a coroutine or green thread,
+    //! otherwise resume each ready thread once. The optional argument value of a yield
+    //! call is ignored here, since a green thread is always resumed without a value.
+    Cell yield(const Cell& val);
+
+    //! Suspend the current thread for the argument duration.
+    void sleep(clock::duration duration);
+
+    //! Return a new channel.
+    std::shared_ptr<Channel> channel();
+
+    //! Remove and return the first message of the channel, wait while the channel is empty.
+    Cell receive(Channel& chan);
+
+    //! Return true, if the coroutine is the running green thread.
+    bool is_current(const Coroutine* coroutine) const noexcept
+    {
+        return is_running && tasks[current].coroutine.get() == coroutine;
+    }
+
+    //! Let the running green thread wait for the argument duration, before it is resumed again.
+    void wait(clock::duration duration) { tasks[current].wakeup = clock::now() + duration; }
+
+    //! Let the running green thread wait for a message of the channel, before it is resumed again.
+    void wait(Channel& chan) { tasks[current].channel = &chan; }
+
+    //! Run all threads until they are finished.
+    void run();
+
+    //! Call function for each message of all channels.
+    template <typename Fun>
+    void for_each_message(Fun&& fun)
+    {
+        for (auto& ptr : channels)
+            if (auto chan = ptr.lock())
+                for (const Cell& msg : chan->messages)
+                    fun(msg);
+    }
+
+private:
+    struct Task {
+        std::shared_ptr<Coroutine> coroutine;
+        clock::time_point wakeup; //!< Earliest time to resume the thread.
+        Channel* channel; //!< Channel, the thread waits for or null-pointer.
+    };
+    bool round();
+    void idle(clock::time_point deadline) const;
+
+    Scheme& scm;
+    std::vector<Task> tasks;
+    std::vector<std::weak_ptr<Channel>> channels;
+    size_t current = 0; //!< Index of the running thread.
+    bool is_running = false; //!< True, while a thread is running.
+};
+
+} // namespace pscm
+
+#endif // COROUTINE_HPP
@@ -0,0 +1,274 @@
+/********************************************************************************/ /**
+ * @file flatmap.hpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#ifndef FLATMAP_HPP
+#define FLATMAP_HPP
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace pscm {
+
+/**
+ * Flat open addressing hash map for a small number of unique keys.
+ *
+ * Up to N (key,value)-pairs are stored inline in the map object itself and up
+ * to linear_max pairs are searched by a linear scan, so that small maps don't
+ * allocate and don't compute hash values. Larger maps switch to a heap
+ * allocated Robin Hood hash table. The heap slots are allocated from a
+ * polymorphic memory resource. There is no erase operation.
+ *
+ * @tparam Key  Key type, which must be equality comparable.
+ * @tparam T    Mapped value type.
+ * @tparam Hash Hash function object for values of type Key.
+ * @tparam N    Number of inline slots.
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>, size_t N = 4>
+class FlatMap {
+    static_assert(N > 0, "invalid inline slot count");
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = size_t;
+
+    static constexpr size_t linear_max = N < 8 ? 8 : N; //!< Maximal size for linear search.
+
+private:
+    //! Storage slot of a (key,value)-pair.
+    struct Slot {
+        uint32_t dist = 0; //!< Probe distance + 1 or zero for an empty slot.
+        alignas(value_type) unsigned char buf[sizeof(value_type)];
+
+        value_type& get() noexcept { return *std::launder(reinterpret_cast<value_type*>(buf)); }
+        const value_type& get() const noexcept { return *std::launder(reinterpret_cast<const value_type*>(buf)); }
+    };
+
+    template <typename SlotT, typename ValueT>
+    struct basic_iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ValueT;
+        using difference_type = std::ptrdiff_t;
+        using pointer = ValueT*;
+        using reference = ValueT&;
+
+        reference operator*() const noexcept { return pos->get(); }
+        pointer operator->() const noexcept { return &pos->get(); }
+
+        basic_iterator& operator++() noexcept
+        {
+            while (++pos != end && !pos->dist)
+                ;
+            return *this;
+        }
+        basic_iterator operator++(int) noexcept
+        {
+            basic_iterator iter{ *this };
+            ++*this;
+            return iter;
+        }
+        bool operator==(const basic_iterator& iter) const noexcept { return pos == iter.pos; }
+        bool operator!=(const basic_iterator& iter) const noexcept { return pos != iter.pos; }
+
+    private:
+        friend class FlatMap;
+        basic_iterator(SlotT* pos, SlotT* end) noexcept
+            : pos{ pos }
+            , end{ end }
+        {
+            while (this->pos != end && !this->pos->dist)
+                ++this->pos;
+        }
+        SlotT *pos, *end;
+    };
+
+public:
+    using iterator = basic_iterator<Slot, value_type>;
+    using const_iterator = basic_iterator<const Slot, const value_type>;
+
+    //! Construct an empty map with capacity for at least count pairs.
+    explicit FlatMap(size_t count = 0, std::pmr::memory_resource* mres = std::pmr::get_default_resource())
+        : mres{ mres }
+    {
+        if (count > N)
+            reserve(count);
+    }
+    FlatMap(const FlatMap&) = delete;
+    FlatMap& operator=(const FlatMap&) = delete;
+
+    ~FlatMap()
+    {
+        clear();
+        deallocate(slots, cap);
+    }
+
+    size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return !count; }
+
+    iterator begin() noexcept { return { slots, slots + cap }; }
+    iterator end() noexcept { return { slots + cap, slots + cap }; }
+    const_iterator begin() const noexcept { return { slots, slots + cap }; }
+    const_iterator end() const noexcept { return { slots + cap, slots + cap }; }
+
+    //! Return an iterator to the pair with argument key or end().
+    iterator find(const Key& key) noexcept
+    {
+        Slot* slot = lookup(key);
+        return slot ? iterator{ slot, slots + cap } : end();
+    }
+
+    const_iterator find(const Key& key) const noexcept
+    {
+        const Slot* slot = const_cast<FlatMap*>(this)->lookup(key);
+        return slot ? const_iterator{ slot, slots + cap } : end();
+    }
+
+    //! Insert a new pair or assign the value of an existing key.
+    template <typename M>
+    void insert_or_assign(const Key& key, M&& val)
+    {
+        if (Slot* slot = lookup(key)) {
+            slot->get().second = std::forward<M>(val);
+            return;
+        }
+        if (is_linear()) {
+            if (count == cap)
+                reserve(count + 1);
+
+            if (is_linear()) {
+                Slot& slot = slots[count++];
+                ::new (slot.buf) value_type{ key, std::forward<M>(val) };
+                slot.dist = 1;
+                return;
+            }
+        } else if (4 * (count + 1) > 3 * cap)
+            rehash(2 * cap);
+
+        insert(value_type{ key, std::forward<M>(val) });
+    }
+
+private:
+    //! Predicate returns true, if pairs are packed into the first slots and searched linearly.
+    bool is_linear() const noexcept { return cap <= linear_max; }
+
+    Slot* lookup(const Key& key) noexcept
+    {
+        if (is_linear()) {
+            for (Slot *slot = slots, *end = slots + count; slot != end; ++slot)
+                if (slot->get().first == key)
+                    return slot;
+
+            return nullptr;
+        }
+        const size_t mask = cap - 1;
+        size_t pos = Hash{}(key) & mask;
+
+        for (uint32_t dist = 1; slots[pos].dist >= dist; ++dist, pos = (pos + 1) & mask)
+            if (slots[pos].get().first == key)
+                return slots + pos;
+
+        return nullptr;
+    }
+
+    //! Robin Hood insert of a new pair, stealing slots from pairs closer to their home position.
+    void insert(value_type&& kv)
+    {
+        const size_t mask = cap - 1;
+        size_t pos = Hash{}(kv.first) & mask;
+
+        for (uint32_t dist = 1;; ++dist, pos = (pos + 1) & mask) {
+            Slot& slot = slots[pos];
+
+            if (!slot.dist) {
+                ::new (slot.buf) value_type{ std::move(kv) };
+                slot.dist = dist;
+                ++count;
+                return;
+            }
+            if (slot.dist < dist) {
+                std::swap(slot.get(), kv);
+                std::swap(slot.dist, dist);
+            }
+        }
+    }
+
+    //! Grow the slot storage to hold at least size pairs.
+    void reserve(size_t size)
+    {
+        if (size <= linear_max)
+            rehash(linear_max);
+        else {
+            size_t n = 16;
+
+            while (4 * size > 3 * n)
+                n *= 2;
+
+            rehash(n);
+        }
+    }
+
+    //! Move all pairs into a new heap allocated slot array of argument capacity.
+    void rehash(size_t size)
+    {
+        Slot *old = slots, *end = slots + cap;
+        const size_t old_cap = cap;
+
+        slots = static_cast<Slot*>(mres->allocate(size * sizeof(Slot), alignof(Slot)));
+        std::uninitialized_default_construct_n(slots, size);
+        cap = size;
+        count = 0;
+
+        for (Slot* slot = old; slot != end; ++slot)
+            if (slot->dist) {
+                if (is_linear()) {
+                    ::new (slots[count].buf) value_type{ std::move(slot->get()) };
+                    slots[count++].dist = 1;
+                } else
+                    insert(std::move(slot->get()));
+
+                slot->get().~value_type();
+                slot->dist = 0;
+            }
+
+        deallocate(old, old_cap);
+    }
+
+    //! Return a heap allocated slot array to the memory resource.
+    void deallocate(Slot* ptr, size_t size) noexcept
+    {
+        if (ptr != local)
+            mres->deallocate(ptr, size * sizeof(Slot), alignof(Slot));
+    }
+
+    //! Destroy all pairs.
+    void clear() noexcept
+    {
+        for (Slot *slot = slots, *end = slots + cap; slot != end; ++slot)
+            if (slot->dist) {
+                slot->get().~value_type();
+                slot->dist = 0;
+            }
+        count = 0;
+    }
+
+    std::pmr::memory_resource* mres; //!< Memory resource for heap allocated slots.
+    Slot local[N]; //!< Inline slots.
+    Slot* slots = local; //!< Either inline or heap allocated slot array.
+    size_t cap = N; //!< Number of slots.
+    size_t count = 0; //!< Number of pairs.
+};
+
+} // namespace pscm
+
+#endif // FLATMAP_HPP
@@ -20,9 +20,25 @@ void GCollector::collect(Scheme& scm, const SymenvPtr& env)
     // Mark phase: mark all reacheable cons-cells
     end = scm.getenv();
     mark(env ? env : end);
+
+    for (const Cell& cell : scm.mvalues)
+        mark(cell);
+
+    scm.scheduler.for_each_message([this](const Cell& cell) { mark(cell); });
+
+    for (const Coroutine* coroutine : scm.coroutines)
+        coroutine->for_each_cell([this](const Cell& cell) { mark(cell); });
+
+    // The optimiser keeps the original expressions of all cons-cells marked so far:
+    mark(scm.optimizer);
     mset.clear();
 
+    // Drop the templates of lambda expressions, which are released:
+    for (auto iter = scm.templates.begin(); iter != scm.templates.end();)
+        iter = is_marked(*iter->first) ? std::next(iter) : scm.templates.erase(iter);
+
     size_t size = scm.store.size();
+    ++count;
 
     // Sweep phase: remove all unmarked cons-cells
     scm.store.remove_if([](Cons& cons) {
@@ -64,6 +80,8 @@ void GCollector::mark(const Cell& cell)
         [this](Cons* cons)            { mark(*cons); },
         [this](const Procedure& proc) { mark(proc); },
         [this](const VectorPtr& vec)  { mark(vec); },
+        [this](const MapPtr& dict)    { mark(dict); },
+        [this](const RecordPtr& rec)  { mark(rec); },
         [this](const SymenvPtr& env)  { mark(env); },
         [](auto&)                     { return; } },
         static_cast<const Cell::base_type&>(cell));
@@ -96,13 +114,39 @@ void GCollector::mark(const Procedure& proc)
 {
     const Cons& code = *get<Cons*>(proc.code());
 
-    if (is_marked(code))
-        return;
+    // closures of the same lambda expression share code but not the environment
+    if (!is_marked(code)) {
+        mark(proc.code());
+        mark(proc.args());
+    }
+    if (!proc.is_template())
+        mark(proc.senv());
+
+    // the next call of a reachable leaf procedure refills its rest parameter cons-cells
+    for (Cons* cons : proc.keep_rest(count))
+        mark(*cons);
+}
+
+/**
+ * Mark the original expressions of all reachable optimised cons-cells, which might
+ * be restored later, and drop all unreachable optimised cons-cells from the optimiser.
+ */
+void GCollector::mark(Optimizer& opt)
+{
+    for (bool again = true; again;) {
+        again = false;
+
+        for (auto& [cons, site] : opt.sites)
+            if (is_marked(*cons) && is_pair(site.original) && !is_marked(*get<Cons*>(site.original))) {
+                mark(site.original);
+                again = true; // original expression might contain further optimised cons-cells
+            }
+    }
+    for (auto iter = opt.sites.begin(); iter != opt.sites.end();)
+        iter = is_marked(*iter->first) ? std::next(iter) : opt.sites.erase(iter);
 
-    mark(proc.code());
-    mark(proc.args());
-    mark(proc.senv());
-    return;
+    for (auto iter = opt.users.begin(); iter != opt.users.end();)
+        iter = opt.sites.count(iter->second) ? std::next(iter) : opt.users.erase(iter);
 }
 
 //! Mark all cons-cells if any, contained in a scheme vector.
@@ -116,6 +160,30 @@ void GCollector::mark(const VectorPtr& vec)
         mark(cell);
 }
 
+//! Mark all cons-cells if any, contained in the keys or values of a scheme dictionary.
+void GCollector::mark(const MapPtr& dict)
+{
+    auto [pos, ok] = mset.insert(reinterpret_cast<size_t>(dict.get()));
+    if (!ok)
+        return; // dictionary already visited
+
+    for (auto& [key, val] : *dict) {
+        mark(key);
+        mark(val);
+    }
+}
+
+//! Mark all cons-cells if any, contained in the fields of a scheme record.
+void GCollector::mark(const RecordPtr& rec)
+{
+    auto [pos, ok] = mset.insert(reinterpret_cast<size_t>(rec.get()));
+    if (!ok)
+        return; // record already visited
+
+    for (auto& cell : rec->slots)
+        mark(cell);
+}
+
 //! Mark all Cons-cells in a list.
 void GCollector::mark(Cons& cons)
 {
@@ -16,6 +16,7 @@
 namespace pscm {
 
 class Scheme;
+class Optimizer;
 
 /**
  * Rudimentary mark-sweep garbage collector.
@@ -31,18 +32,25 @@ public:
 
     void logging(bool); //! Enable/disable gc summary logging
 
+    //! Return the number of garbage collector cycles.
+    size_t cycles() const noexcept { return count; }
+
 private:
     bool is_marked(const Cons&) const noexcept;
 
     void mark(const Cell&);
     void mark(const Procedure&);
     void mark(const VectorPtr&);
+    void mark(const MapPtr&);
+    void mark(const RecordPtr&);
+    void mark(Optimizer&);
     void mark(SymenvPtr);
     void mark(Cons&);
 
     std::set<size_t> mset;
     SymenvPtr end = nullptr;
     bool logon = false;
+    size_t count = 0;
 };
 
 } // namespace pscm
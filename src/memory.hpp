@@ -0,0 +1,176 @@
+/********************************************************************************/ /**
+ * @file memory.hpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <algorithm>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace pscm {
+
+//! Exception class, thrown if an allocation would exceed the memory budget
+//! of a scheme interpreter or if the upstream memory resource is out of memory.
+struct memory_exhausted : public std::runtime_error {
+    explicit memory_exhausted(size_t limit)
+        : std::runtime_error{ "out of memory, budget of " + std::to_string(limit) + " bytes exhausted" }
+        , limit{ limit }
+    {
+    }
+    size_t limit; //!< Memory budget in bytes at the time of the allocation failure.
+};
+
+/**
+ * Memory resource, which limits the total number of bytes allocated
+ * from an upstream memory resource.
+ *
+ * An allocation exceeding the byte limit throws a ::memory_exhausted exception and
+ * marks the budget as exhausted. While exhausted, allocations may additionally use a
+ * small reserve, to handle the out of memory condition, for example to build an
+ * error object and to run an exception handler. The exhausted state is reset
+ * by clear(), after the interpreter released unreachable memory.
+ */
+class MemoryBudget : public std::pmr::memory_resource {
+public:
+    static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+    static constexpr size_t dflt_reserve = 4096; //!< Default reserve in bytes.
+
+    explicit MemoryBudget(std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+        size_t limit = unlimited, size_t reserve = dflt_reserve) noexcept
+        : upstream{ upstream }
+        , max_bytes{ limit }
+        , reserve_bytes{ reserve }
+    {
+    }
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    std::pmr::memory_resource* upstream_resource() const noexcept { return upstream; }
+
+    size_t limit() const noexcept { return max_bytes; } //!< Return the byte limit.
+    void limit(size_t size) noexcept { max_bytes = size; } //!< Set a new byte limit.
+
+    size_t used() const noexcept { return used_bytes; } //!< Return the number of currently allocated bytes.
+    size_t peak() const noexcept { return peak_bytes; } //!< Return the maximal number of allocated bytes.
+
+    //! Return the number of bytes still available until the limit is reached.
+    size_t available() const noexcept { return used_bytes < max_bytes ? max_bytes - used_bytes : 0; }
+
+    //! Predicate returns true, if an allocation failed since the last call of clear().
+    bool exhausted() const noexcept { return is_exhausted; }
+
+    //! Reset the exhausted state, to disable the reserve again.
+    void clear() noexcept { is_exhausted = false; }
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        size_t limit = max_bytes;
+
+        if (is_exhausted)
+            limit = max_bytes < unlimited - reserve_bytes ? max_bytes + reserve_bytes : unlimited;
+
+        if (bytes > limit || used_bytes > limit - bytes)
+            fail();
+
+        void* ptr = nullptr;
+        try {
+            ptr = upstream->allocate(bytes, align);
+        } catch (const std::bad_alloc&) {
+            fail();
+        }
+        used_bytes += bytes;
+        peak_bytes = std::max(peak_bytes, used_bytes);
+        return ptr;
+    }
+
+    void do_deallocate(void* ptr, size_t bytes, size_t align) override
+    {
+        upstream->deallocate(ptr, bytes, align);
+        used_bytes -= bytes;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    [[noreturn]] void fail()
+    {
+        is_exhausted = true;
+        throw memory_exhausted{ max_bytes };
+    }
+
+    std::pmr::memory_resource* upstream;
+    size_t max_bytes;
+    size_t reserve_bytes;
+    size_t used_bytes = 0;
+    size_t peak_bytes = 0;
+    bool is_exhausted = false;
+};
+
+/**
+ * Pool memory resource, which counts its live blocks.
+ *
+ * An unsynchronized pool resource never hands a deallocated block back to its
+ * upstream resource. Blocks with a nested lifetime, like call frames, are recycled
+ * by the pool, but all pooled memory is only handed back upstream by release(),
+ * once no block is live anymore.
+ */
+class FramePool : public std::pmr::memory_resource {
+public:
+    explicit FramePool(std::pmr::memory_resource* upstream)
+        : pool{ upstream }
+    {
+    }
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    size_t live() const noexcept { return count; } //!< Return the number of live blocks.
+
+    //! Hand all pooled memory back to the upstream resource, if no block is live.
+    //! Return false, if there is a live block.
+    bool release() noexcept
+    {
+        if (count)
+            return false;
+
+        pool.release();
+        return true;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        void* ptr = pool.allocate(bytes, align);
+        ++count;
+        return ptr;
+    }
+
+    void do_deallocate(void* ptr, size_t bytes, size_t align) override
+    {
+        pool.deallocate(ptr, bytes, align);
+        --count;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::unsynchronized_pool_resource pool;
+    size_t count = 0;
+};
+
+} // namespace pscm
+
+#endif // MEMORY_HPP
@@ -40,28 +40,6 @@ bool is_odd(const Number& num)
     return visit(number, static_cast<const Number::base_type&>(num));
 }
 
-/**
- * @brief Check wheter an integer addition of both argument values would overflow.
- */
-constexpr bool overflow_add(Int a, Int b)
-{
-    constexpr Int min = std::numeric_limits<Int>::min(),
-                  max = std::numeric_limits<Int>::max();
-
-    return (b > 0 && a > max - b) || (b < 0 && a < min - b);
-}
-
-/**
- * @brief Check wheater integer substraction of both arguments values would overflow.
- */
-constexpr bool overflow_sub(Int a, Int b)
-{
-    constexpr Int min = std::numeric_limits<Int>::min(),
-                  max = std::numeric_limits<Int>::max();
-
-    return (b > 0 && a < min + b) || (b < 0 && a > max + b);
-}
-
 //! Predicate function to test wheter the argument numbers aren't equal.
 bool operator!=(const Number& lhs, const Number& rhs)
 {
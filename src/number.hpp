@@ -11,6 +11,7 @@
 
 #include <complex>
 #include <iostream>
+#include <limits>
 #include <variant>
 
 #include "utils.hpp"
@@ -172,6 +173,42 @@ Number num(const T& x) { return { x }; }
 template <typename RE, typename IM>
 Number num(const RE& x, const IM& y) { return { x, y }; }
 
+/**
+ * @brief Check wheter an integer addition of both argument values would overflow.
+ */
+constexpr bool overflow_add(Int a, Int b)
+{
+    constexpr Int min = std::numeric_limits<Int>::min(),
+                  max = std::numeric_limits<Int>::max();
+
+    return (b > 0 && a > max - b) || (b < 0 && a < min - b);
+}
+
+/**
+ * @brief Check wheater integer substraction of both arguments values would overflow.
+ */
+constexpr bool overflow_sub(Int a, Int b)
+{
+    constexpr Int min = std::numeric_limits<Int>::min(),
+                  max = std::numeric_limits<Int>::max();
+
+    return (b > 0 && a < min + b) || (b < 0 && a > max + b);
+}
+
+/**
+ * @brief Check wheter an integer multiplication of both argument values would overflow.
+ */
+constexpr bool overflow_mul(Int a, Int b)
+{
+    constexpr Int min = std::numeric_limits<Int>::min(),
+                  max = std::numeric_limits<Int>::max();
+
+    if (a > 0)
+        return b > 0 ? a > max / b : b < min / a;
+    else
+        return b > 0 ? a < min / b : a && b < max / a;
+}
+
 inline bool is_int(const Number& num) { return is_type<Int>(num); }
 inline bool is_float(const Number& num) { return is_type<Float>(num); }
 inline bool is_complex(const Number& num) { return is_type<Complex>(num); }
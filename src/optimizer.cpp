@@ -0,0 +1,449 @@
+/********************************************************************************/ /**
+ * @file optimizer.cpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#include <algorithm>
+
+#include "optimizer.hpp"
+#include "primop.hpp"
+#include "scheme.hpp"
+
+namespace pscm {
+
+//! Optimisation state of a lambda body.
+struct Optimizer::Context {
+    Scheme& scm;
+    const SymenvPtr& env; //!< Closure environment.
+    const std::pmr::vector<Symbol>& scope; //!< Symbols bound by a call frame.
+    const Symenv* top; //!< Top environment of the interpreter.
+    size_t depth; //!< Nesting depth of inlined procedure bodies.
+};
+
+//! Result of the inspection of a procedure body, to decide whether a call can be inlined.
+struct Optimizer::Inline {
+    const Symbol& sym; //!< Global symbol of the procedure.
+    Cell formals; //!< Proper formal parameter list.
+    Cell args; //!< Argument expression list of the call.
+    std::vector<size_t> count; //!< Number of references of each formal parameter.
+    std::vector<size_t> order; //!< Formal parameter index of each variable reference in evaluation order, or count.size() for a global variable.
+    size_t size = 0; //!< Number of cons-cells of the procedure body.
+    bool is_valid = true; //!< Body can be inlined.
+    bool is_pure = true; //!< Body only calls pure primary functions.
+    bool is_conditional = false; //!< Body contains conditional expressions.
+
+    //! Return the index of a formal parameter symbol or the number of formal parameters, if not found.
+    size_t index(const Symbol& sym) const
+    {
+        size_t idx = 0;
+
+        for (Cell iter = formals; is_pair(iter) && get<Symbol>(car(iter)) != sym; iter = cdr(iter))
+            ++idx;
+
+        return idx;
+    }
+};
+
+Optimizer::Optimizer(std::pmr::memory_resource* mres)
+    : mres{ mres }
+    , sites{ mres }
+    , users{ mres }
+{
+}
+
+void Optimizer::enable(bool on)
+{
+    if (!(is_enabled = on))
+        deoptimize();
+}
+
+void Optimizer::deoptimize()
+{
+    for (auto& [cons, site] : sites)
+        get<0>(*cons) = site.original;
+
+    sites.clear();
+    users.clear();
+}
+
+void Optimizer::restore(const Symbol& sym)
+{
+    auto [first, last] = users.equal_range(sym);
+
+    for (auto iter = first; iter != last; ++iter)
+        if (auto site = sites.find(iter->second); site != sites.end()) {
+            get<0>(*iter->second) = site->second.original;
+            sites.erase(site);
+        }
+    users.erase(first, last);
+}
+
+/**
+ * Replace the car slot of argument cons-cell by a new value. An already rewritten
+ * cons-cell keeps its first original expression.
+ *
+ * @param sym Optional global symbol, the new value depends on.
+ */
+void Optimizer::rewrite(Cons* cons, const Cell& val, const Cell& original, const Symbol* sym)
+{
+    if (auto [iter, ok] = sites.try_emplace(cons, mres); ok)
+        iter->second.original = original;
+
+    get<0>(*cons) = val;
+
+    if (sym)
+        depend(cons, *sym);
+}
+
+void Optimizer::depend(Cons* cons, const Symbol& sym)
+{
+    auto& deps = sites.at(cons).deps;
+
+    if (std::find(deps.begin(), deps.end(), sym) == deps.end()) {
+        deps.push_back(sym);
+        users.emplace(sym, cons);
+    }
+}
+
+//! Add all dependencies of an optimised cons-cell to another optimised cons-cell.
+void Optimizer::inherit(Cons* cons, Cons* from)
+{
+    if (auto iter = sites.find(from); iter != sites.end())
+        for (const Symbol& sym : iter->second.deps)
+            depend(cons, sym);
+}
+
+//! Return the original expression of the car slot of argument cons-cell.
+Cell Optimizer::original(const Cell& cell) const
+{
+    Cons* cons = get<Cons*>(cell);
+    auto iter = sites.find(cons);
+    return iter != sites.end() ? iter->second.original : get<0>(*cons);
+}
+
+/**
+ * Return a pointer to the value of a global symbol in the top environment or
+ * a null-pointer, if the symbol might be bound by a call frame of the lambda
+ * expression or by any environment between the closure and the top environment.
+ */
+const Cell* Optimizer::global(const Context& ctx, const Symbol& sym) const
+{
+    if (std::binary_search(ctx.scope.begin(), ctx.scope.end(), sym))
+        return nullptr;
+
+    for (const Symenv* senv = ctx.env.get(); senv != ctx.top; senv = senv->parent().get())
+        if (!senv || !senv->scope() || std::binary_search(senv->scope()->begin(), senv->scope()->end(), sym))
+            return nullptr;
+
+    return ctx.top->find(sym);
+}
+
+void Optimizer::optimize(Scheme& scm, const SymenvPtr& env, const std::pmr::vector<Symbol>& scope, const Cell& code)
+{
+    SymenvPtr top = scm.getenv();
+
+    // Bindings of the environment of another interpreter might change unnoticed:
+    if (!is_enabled || top->parent())
+        return;
+
+    Context ctx{ scm, env, scope, top.get(), 0 };
+    sequence(ctx, code);
+}
+
+void Optimizer::sequence(Context& ctx, Cell list)
+{
+    for (/* */; is_pair(list); list = cdr(list))
+        expression(ctx, get<Cons*>(list));
+}
+
+//! Optimise the expression in the car slot of argument cons-cell.
+void Optimizer::expression(Context& ctx, Cons* cons)
+{
+    Cell expr = get<0>(*cons);
+
+    if (is_symbol(expr)) {
+        if (const Cell* val = global(ctx, get<Symbol>(expr)); val && is_number(*val))
+            rewrite(cons, *val, expr, &get<Symbol>(expr));
+        return;
+    }
+    if (!is_pair(expr))
+        return;
+
+    Cons* call = get<Cons*>(expr);
+    Cell op = get<0>(*call), val = op;
+
+    if (is_symbol(op)) {
+        const Cell* ptr = global(ctx, get<Symbol>(op));
+
+        if (!ptr)
+            return sequence(ctx, get<1>(*call)); // local procedure
+
+        val = *ptr;
+    } else if (is_pair(op)) {
+        expression(ctx, call);
+        return sequence(ctx, get<1>(*call));
+    }
+    const Symbol* sym = is_symbol(op) ? &get<Symbol>(op) : nullptr;
+
+    if (is_intern(val)) {
+        Intern opcode = get<Intern>(val);
+
+        if (sym && !is_environment_primop(opcode))
+            rewrite(call, val, op, sym);
+
+        switch (opcode) {
+        case Intern::_quote:
+        case Intern::_lambda:
+        case Intern::_macro:
+        case Intern::_define_syntax:
+        case Intern::_define_record_type:
+        case Intern::_syntax_rules:
+        case Intern::_quasiquote:
+        case Intern::_unquote:
+        case Intern::_unquotesplice:
+        case Intern::_else:
+        case Intern::_arrow:
+            return;
+
+        case Intern::_define: // (define symbol expr), a procedure definition is optimised on its own
+            if (is_pair(cdr(expr)) && is_symbol(cadr(expr)))
+                sequence(ctx, cddr(expr));
+            return;
+
+        case Intern::_setb: // (set! symbol expr)
+            if (is_pair(cdr(expr)))
+                sequence(ctx, cddr(expr));
+            return;
+
+        case Intern::_receive: // (receive formals expr body ...), the formals are part of the scope
+            if (is_pair(cdr(expr)))
+                sequence(ctx, cddr(expr));
+            return;
+
+        case Intern::_let_values: // (let-values ((formals expr) ...) body ...)
+            if (is_pair(cdr(expr))) {
+                for (Cell iter = cadr(expr); is_pair(iter); iter = cdr(iter))
+                    if (is_pair(car(iter)))
+                        sequence(ctx, cdar(iter));
+
+                sequence(ctx, cddr(expr));
+            }
+            return;
+
+        case Intern::_cond: // (cond (test expr ...) ...)
+            for (Cell clause = cdr(expr); is_pair(clause); clause = cdr(clause))
+                if (is_pair(car(clause)))
+                    sequence(ctx, car(clause));
+            return;
+
+        default:
+            sequence(ctx, cdr(expr));
+
+            if (is_pure_primop(opcode))
+                fold(ctx, cons, opcode);
+            return;
+        }
+    }
+    if (is_macro(val))
+        return; // arguments are unevaluated expressions
+
+    sequence(ctx, cdr(expr));
+
+    if (sym && is_proc(val) && !inline_call(ctx, cons, get<Procedure>(val), *sym))
+        rewrite(call, val, op, sym);
+}
+
+//! Replace a call of a pure primary function with constant arguments by its result.
+void Optimizer::fold(Context& ctx, Cons* cons, Intern opcode)
+{
+    Cons* call = get<Cons*>(get<0>(*cons));
+    std::vector<Cell> argv;
+    Cell iter = get<1>(*call);
+
+    for (/* */; is_pair(iter); iter = cdr(iter))
+        if (const Cell& arg = car(iter); is_number(arg) || is_bool(arg) || is_char(arg))
+            argv.push_back(arg);
+        else
+            return;
+
+    if (!is_nil(iter))
+        return;
+
+    Cell val;
+    try {
+        val = ctx.scm.apply(ctx.env, opcode, argv);
+    } catch (const std::exception&) {
+        return; // report the error at evaluation time
+    }
+    if (!is_number(val) && !is_bool(val) && !is_char(val))
+        return;
+
+    rewrite(cons, val, call, nullptr);
+    inherit(cons, call);
+
+    for (iter = get<1>(*call); is_pair(iter); iter = cdr(iter))
+        inherit(cons, get<Cons*>(iter));
+}
+
+/**
+ * Replace a procedure call by the procedure body with all formal parameters
+ * substituted by the argument expressions.
+ *
+ * Only calls of small leaf procedures of the top environment, with a single
+ * body expression and a proper formal parameter list are inlined. An argument
+ * expression, which is not a constant or symbol, must be evaluated exactly once by
+ * a procedure body of pure primary function calls only. The argument expressions
+ * must be evaluated in the order of the formal parameters, before the body reads
+ * any global variable. Otherwise, the call is kept, which binds the arguments in a
+ * call frame.
+ */
+bool Optimizer::inline_call(Context& ctx, Cons* cons, const Procedure& proc, const Symbol& sym)
+{
+    if (ctx.depth >= max_inline_depth || proc.is_macro() || !proc.is_leaf()
+        || get<SymenvPtr>(proc.senv()).get() != ctx.top || !is_nil(cdr(proc.code())))
+        return false;
+
+    Cons* call = get<Cons*>(get<0>(*cons));
+    Cell formal = proc.args(), arg = get<1>(*call);
+    std::vector<Cell> argv; // argument list cons-cells
+
+    for (/* */; is_pair(formal) && is_pair(arg); formal = cdr(formal), arg = cdr(arg))
+        argv.push_back(arg);
+
+    if (!is_nil(formal) || !is_nil(arg))
+        return false;
+
+    Inline info{ sym, proc.args(), get<1>(*call), std::vector<size_t>(argv.size(), 0), {} };
+    inspect(ctx, info, original(proc.code()));
+
+    if (!info.is_valid)
+        return false;
+
+    for (size_t idx = 0; idx < argv.size(); ++idx)
+        if (is_pair(car(argv[idx])) ? info.count[idx] != 1 || !info.is_pure || info.is_conditional
+                                    : is_symbol(car(argv[idx])) && info.count[idx] > 1 && !info.is_pure)
+            return false;
+
+    // Up to the last argument expression, variable references must read the non-constant
+    // arguments in the order of the formal parameters. A global constant is a variable too:
+    auto last = std::find_if(info.order.rbegin(), info.order.rend(), [&argv](size_t idx) {
+        return idx < argv.size() && is_pair(car(argv[idx]));
+    });
+    size_t next = 0;
+
+    for (auto iter = info.order.begin(); iter != last.base(); ++iter) {
+        if (*iter < argv.size() && !is_pair(car(argv[*iter])) && !is_symbol(original(argv[*iter])))
+            continue; // constant argument
+
+        if (*iter == argv.size() || *iter < next)
+            return false;
+
+        next = *iter + 1;
+    }
+
+    Cell body = substitute(ctx.scm, info, original(proc.code()));
+
+    rewrite(cons, body, get<0>(*cons), &sym);
+
+    for (arg = info.args; is_pair(arg); arg = cdr(arg))
+        inherit(cons, get<Cons*>(arg));
+
+    ++ctx.depth;
+    expression(ctx, cons);
+    --ctx.depth;
+    return true;
+}
+
+//! Count the references of formal parameters and check, whether all other symbols are global.
+void Optimizer::inspect(const Context& ctx, Inline& info, const Cell& expr, bool is_operator) const
+{
+    if (!info.is_valid)
+        return;
+
+    if (is_symbol(expr)) {
+        const Symbol& sym = get<Symbol>(expr);
+        size_t idx = info.index(sym);
+
+        if (idx < info.count.size())
+            ++info.count[idx];
+        else if (sym == info.sym || !global(ctx, sym))
+            info.is_valid = false; // recursive call or local symbol of the call site
+
+        if (idx < info.count.size() || !is_operator)
+            info.order.push_back(idx);
+        return;
+    }
+    if (!is_pair(expr))
+        return;
+
+    if (++info.size > max_inline_size)
+        return void(info.is_valid = false);
+
+    Cell op = original(expr), val = none;
+    inspect(ctx, info, op, true);
+
+    if (is_symbol(op) && info.index(get<Symbol>(op)) == info.count.size())
+        if (const Cell* ptr = global(ctx, get<Symbol>(op)))
+            val = *ptr;
+
+    if (is_intern(val))
+        switch (Intern opcode = get<Intern>(val)) {
+        case Intern::_if:
+        case Intern::_cond:
+        case Intern::_when:
+        case Intern::_unless:
+        case Intern::_and:
+        case Intern::_or:
+        case Intern::_begin:
+            info.is_conditional = true;
+            break;
+
+        default:
+            if (opcode < Intern::op_eq || is_environment_primop(opcode))
+                return void(info.is_valid = false); // binding or quoting syntax
+
+            info.is_pure = info.is_pure && is_pure_primop(opcode);
+            break;
+        }
+    else if (is_macro(val))
+        return void(info.is_valid = false);
+    else
+        info.is_pure = false; // procedure, formal parameter or computed operator
+
+    Cell iter = cdr(expr);
+
+    for (/* */; is_pair(iter); iter = cdr(iter)) {
+        ++info.size;
+        inspect(ctx, info, original(iter));
+    }
+    if (!is_nil(iter))
+        info.is_valid = false;
+}
+
+//! Return a copy of argument expression with all formal parameters substituted by the argument expressions.
+Cell Optimizer::substitute(Scheme& scm, const Inline& info, const Cell& expr) const
+{
+    if (is_symbol(expr)) {
+        Cell arg = info.args;
+
+        for (Cell iter = info.formals; is_pair(iter); iter = cdr(iter), arg = cdr(arg))
+            if (get<Symbol>(car(iter)) == get<Symbol>(expr))
+                return car(arg);
+
+        return expr;
+    }
+    if (!is_pair(expr))
+        return expr;
+
+    Cell head = scm.cons(substitute(scm, info, original(expr)), nil), tail = head;
+
+    for (Cell iter = cdr(expr); is_pair(iter); iter = cdr(iter), tail = cdr(tail))
+        set_cdr(tail, scm.cons(substitute(scm, info, original(iter)), nil));
+
+    return head;
+}
+
+} // namespace pscm
@@ -0,0 +1,116 @@
+/********************************************************************************/ /**
+ * @file optimizer.hpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "cell.hpp"
+
+namespace pscm {
+
+class Scheme;
+class GCollector;
+
+/**
+ * Optional optimiser of closed lambda expressions.
+ *
+ * The optimiser rewrites the body of a lambda expression in place, before its first
+ * evaluation. All rewrites depend on the unchanged binding of global symbols in the
+ * top environment, which are not shadowed by any local binding of the lambda expression
+ * or of its closure environments:
+ *
+ * - Operator symbols bound to a primary function, a syntax opcode or a procedure are
+ *   replaced by their value, to avoid the symbol lookup at each evaluation.
+ * - Symbols bound to a global number constant, like %pi, are replaced by their value.
+ * - Calls of pure primary functions with constant arguments are folded into their result.
+ * - Calls of small, non-recursive procedures with a single body expression are replaced
+ *   by the procedure body, where the formal parameters are substituted by the arguments.
+ *
+ * Each rewritten expression is registered together with its original expression
+ * and all global symbols it depends on. Any redefinition or assignment of such a symbol
+ * restores the original expression.
+ *
+ * @remark The optimiser assumes, that a lambda expression is always evaluated in
+ *         environments, which bind the same local symbols.
+ */
+class Optimizer {
+public:
+    static constexpr size_t max_inline_size = 24; //!< Maximal number of cons-cells of an inlined body.
+    static constexpr size_t max_inline_depth = 3; //!< Maximal nesting depth of inlined procedures.
+
+    explicit Optimizer(std::pmr::memory_resource* mres = std::pmr::get_default_resource());
+
+    bool enabled() const noexcept { return is_enabled; } //!< Return true, if the optimiser is enabled.
+
+    //! Enable or disable the optimiser. Disabling restores all optimised expressions.
+    void enable(bool on);
+
+    /**
+     * Optimise the body expressions of a closed lambda expression.
+     *
+     * @param env   Closure environment of the lambda expression.
+     * @param scope Sorted symbols, which are bound by a call frame of the lambda expression.
+     * @param code  Lambda body expression list.
+     */
+    void optimize(Scheme& scm, const SymenvPtr& env, const std::pmr::vector<Symbol>& scope, const Cell& code);
+
+    //! Restore all optimised expressions, which depend on the global binding of argument symbol.
+    void deoptimize(const Symbol& sym)
+    {
+        if (!sites.empty())
+            restore(sym);
+    }
+
+    //! Restore all optimised expressions.
+    void deoptimize();
+
+    //! Return the original expression of the car slot of argument cons-cell.
+    Cell original(const Cell& cell) const;
+
+private:
+    friend class GCollector;
+
+    //! Original expression of a rewritten car slot of a cons-cell and the global symbols the rewrite depends on.
+    struct Site {
+        Site(std::pmr::memory_resource* mres)
+            : deps{ mres }
+        {
+        }
+        Cell original;
+        std::pmr::vector<Symbol> deps;
+    };
+    struct Context;
+    struct Inline;
+
+    void restore(const Symbol& sym);
+    void rewrite(Cons* cons, const Cell& val, const Cell& original, const Symbol* sym);
+    void depend(Cons* cons, const Symbol& sym);
+    void inherit(Cons* cons, Cons* from);
+
+    const Cell* global(const Context& ctx, const Symbol& sym) const;
+
+    void expression(Context& ctx, Cons* cons);
+    void sequence(Context& ctx, Cell list);
+    void fold(Context& ctx, Cons* cons, Intern opcode);
+    bool inline_call(Context& ctx, Cons* cons, const Procedure& proc, const Symbol& sym);
+    void inspect(const Context& ctx, Inline& info, const Cell& expr, bool is_operator = false) const;
+    Cell substitute(Scheme& scm, const Inline& info, const Cell& expr) const;
+
+    std::pmr::memory_resource* mres;
+    std::pmr::unordered_map<Cons*, Site> sites; //!< Rewritten cons-cells.
+    std::pmr::unordered_multimap<Symbol, Cons*, Symbol::hash> users; //!< Rewritten cons-cells by global symbol.
+    bool is_enabled = false;
+};
+
+} // namespace pscm
+
+#endif // OPTIMIZER_HPP
@@ -82,7 +82,7 @@ Parser::Token Parser::lex_number(const String& str, Number& num)
 
                 if (!strchr("eE", *(ic - 1))) {
                     is_cpx = true;
-                    z.real(std::stod(str.substr(0, pos = ip)));
+                    z.real(std::stod(string_convert<Char>(str.substr(0, pos = ip))));
 
                     if (*ic != '+')
                         z.imag(-1);
@@ -91,8 +91,8 @@ Parser::Token Parser::lex_number(const String& str, Number& num)
                 is_cpx = true;
 
                 if (iswdigit(str.at(pos)) || pos + 2 < str.size())
-                    z.imag(z.imag() >= 0 ? std::stod(str.substr(pos, str.size()))
-                                         : -std::stod(str.substr(pos, str.size())));
+                    z.imag(z.imag() >= 0 ? std::stod(string_convert<Char>(str.substr(pos)))
+                                         : -std::stod(string_convert<Char>(str.substr(pos))));
             } else
                 return Token::Error;
         }
@@ -105,9 +105,9 @@ Parser::Token Parser::lex_number(const String& str, Number& num)
             //   num = Number{ std::stod(str) };
         } else {
             try {
-                num = std::stol(str);
+                num = std::stol(string_convert<Char>(str));
             } catch (std::out_of_range&) {
-                num = Number{ std::stod(str) };
+                num = Number{ std::stod(string_convert<Char>(str)) };
             }
         }
         return Token::Number;
@@ -293,7 +293,7 @@ Parser::Token Parser::lex_char(const String& str, Char& c, istream_type& in)
     } else if (str.size() > 3 && str[2] == MYL('x')) {
         String s{ str.substr(1) };
         s[0] = MYL('0');
-        c = static_cast<Char>(stoi(s));
+        c = static_cast<Char>(stoi(string_convert<Char>(s)));
         return Token::Char;
     } else {
         String name;
@@ -522,7 +522,7 @@ Cell Parser::read(istream_type& in)
             return numtok;
 
         case Token::String:
-            return str(strtok);
+            return scm.str(strtok);
 
         case Token::Regex:
             return regex(strtok);
@@ -548,7 +548,7 @@ Cell Parser::read(istream_type& in)
 //! Read a scheme vector from stream.
 Cell Parser::parse_vector(istream_type& in)
 {
-    VectorPtr vptr = vec(0, none);
+    VectorPtr vptr = scm.vec();
     Token tok = get_token(in);
 
     if (tok == Token::OBrace)
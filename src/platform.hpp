@@ -6,15 +6,51 @@
 
 #define PLATFORM_ESP32
 
+// An instrumented build requires much more native stack for the same evaluation depth:
+#if defined(__SANITIZE_ADDRESS__) && !defined(PLATFORM_STACK_RESERVE)
+#define PLATFORM_STACK_RESERVE 262144
+#endif
+
 #ifdef PLATFORM_ESP32
 
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #define PLATFORM_CHAR
 
+// Lowest native stack address of the calling task, the stack grows downwards:
+#define PLATFORM_STACK_START(top) (reinterpret_cast<const char*>(pxTaskGetStackStart(nullptr)))
+
+// Native stack bytes kept free for primitive functions and exception handling, at most
+// a quarter of the stack, which is left at the outermost evaluation:
+#ifndef PLATFORM_STACK_RESERVE
+#define PLATFORM_STACK_RESERVE 4096
+#endif
+
+// Frames of the explicit evaluation stack of each coroutine:
+#ifndef PLATFORM_COROUTINE_FRAMES
+#define PLATFORM_COROUTINE_FRAMES 1024
+#endif
+
 #else
 #define PLATFORM_WCHAR
+
+// Assume, that the outermost evaluation starts near the top of the native stack:
+#define PLATFORM_STACK_START(top) (static_cast<const char*>(top) - PLATFORM_STACK_SIZE)
+
+#ifndef PLATFORM_STACK_SIZE
+#define PLATFORM_STACK_SIZE 1048576
+#endif
+
+#ifndef PLATFORM_STACK_RESERVE
+#define PLATFORM_STACK_RESERVE 65536
+#endif
+
+#ifndef PLATFORM_COROUTINE_FRAMES
+#define PLATFORM_COROUTINE_FRAMES 16384
+#endif
 #endif
 
 #ifdef PLATFORM_CHAR
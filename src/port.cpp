@@ -148,6 +148,18 @@ OSTREAM& operator<<(OSTREAM& os, Intern opcode)
         return os << "lambda";
     case Intern::_macro:
         return os << "define-macro";
+    case Intern::_define_syntax:
+        return os << "define-syntax";
+    case Intern::_define_record_type:
+        return os << "define-record-type";
+    case Intern::_syntax_rules:
+        return os << "syntax-rules";
+    case Intern::_receive:
+        return os << "receive";
+    case Intern::_let_values:
+        return os << "let-values";
+    case Intern::_values:
+        return os << "#<values>";
     case Intern::_apply:
         return os << "apply";
     case Intern::_quote:
@@ -183,6 +195,8 @@ OSTREAM& operator<<(OSTREAM& os, const Cell& cell)
         [&os](const StringPtr& arg)   -> OSTREAM& { return os << '"' << *arg << '"';},
         [&os](const RegexPtr&)        -> OSTREAM& { return os << "#<regex>"; },
         [&os](const MapPtr&)          -> OSTREAM& { return os << "#<dict>"; },
+        [&os](const RecordPtr& arg)   -> OSTREAM& { return arg->type ? (os << "#<record " << arg->type->slots[0] << '>')
+                                                                     : (os << "#<record-type " << arg->slots[0] << '>'); },
         [&os](const SymenvPtr& arg)   -> OSTREAM& { return os << "#<symenv " << arg.get() << '>'; },
         [&os](const FunctionPtr& arg) -> OSTREAM& { return os << "#<function " << arg->name() << '>'; },
         [&os](const PortPtr&)         -> OSTREAM& { return os << "#<port>"; },
@@ -164,7 +164,7 @@ public:
     using openmode = typename Port<Char>::openmode;
     using stream_type::eof;
 
-    explicit FilePort(const std::basic_string<Char>& filename, openmode mode)
+    explicit FilePort(std::basic_string_view<Char> filename, openmode mode)
         : stream_type{ string_convert<char>(filename), mode }
         , Port<Char>{ *this, mode }
     {
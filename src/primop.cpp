@@ -11,18 +11,24 @@
  *************************************************************************************/
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
 
+#include "coroutine.hpp"
 #include "gc.hpp"
 #include "parser.hpp"
 #include "primop.hpp"
 #include "procedure.hpp"
 #include "scheme.hpp"
+#include "translator.hpp"
 
 //#define PSCM_REGEXPS
 //#ifdef PSCM_DICTIONARY
 
+//! Argument vector of the external function signature. It is allocated from the default heap and
+//! released at the end of each call, so that it isn't accounted by the interpreter memory budget.
 using varg = std::vector<pscm::Cell>;
 
 namespace pscm::primop {
@@ -264,11 +270,11 @@ static Cell inex2ex(const Cell& cell)
                                                    : Number{ static_cast<Int>(get<Float>(real(num))) };
 }
 
-static Cell numstr(const varg& args)
+static Cell numstr(Scheme& scm, const varg& args)
 {
     std::basic_ostringstream<Char> buf;
     buf << get<Number>(args.at(0));
-    return std::make_shared<StringPtr::element_type>(buf.str());
+    return scm.str(buf.str());
 }
 
 /**
@@ -484,10 +490,29 @@ static Cell apply(Scheme& scm, const SymenvPtr& senv, const Cell& proc, const va
 
             set_car(cdr(argv), head);
             set_cdr(cddr(expr), nil);
-            return scm.eval(senv, expr);
+            return scm.unwind_check(scm.eval(senv, expr));
         }
     } else
+        return scm.unwind_check(scm.apply(senv, proc, args));
+}
+
+/**
+ * Apply a procedure inside the extent of an escape point.
+ *
+ * In contrast to apply, a non-local exit returns from this function without an
+ * exception, since the caller is the escape point itself.
+ */
+static Cell escape_apply(Scheme& scm, const SymenvPtr& senv, const Cell& proc, const varg& args)
+{
+    if (!pscm::is_proc(proc))
         return scm.apply(senv, proc, args);
+
+    Cons exp[3], lst[2], argv[1];
+    Cell arg_list = args.empty() ? Cell{ nil }
+        : args.size() == 1      ? Cell{ pscm::list(argv, args[0]) }
+                                : primop::list(scm, args);
+
+    return scm.eval(senv, pscm::list(exp, Intern::_apply, proc, pscm::list(lst, Intern::_quote, arg_list)));
 }
 
 static Cell apply(Scheme& scm, const SymenvPtr& senv, const varg& args)
@@ -510,125 +535,78 @@ static Cell vec2list(Scheme& scm, const varg& args);
 /**
  * Call with current continuation.
  *
- * Simple implementation as escape continuation
+ * Simple implementation as escape continuation. Calling the continuation starts
+ * a non-local exit, where each active evaluation returns immediately up to this
+ * escape point. Only C++ functions between the continuation call and this escape
+ * point are left by an ::unwind_exception. Multiple continuation arguments are
+ * returned as multiple values.
  */
 static Cell callcc(Scheme& scm, const SymenvPtr& senv, const varg& args)
 {
-    struct continuation_exception {
-        continuation_exception(Scheme& scm, const varg& args)
-        {
-            if (args.empty())
-                return;
+    Scheme::Escape escape{ scm };
 
-            continuation = args.size() != 1 ? primop::list(scm, args) : args[0];
-        }
-        Cell continuation = none;
-    };
-    auto lambda = [](Scheme& scm, const SymenvPtr&, const varg& args) -> Cell {
-        throw continuation_exception{ scm, args };
+    auto lambda = [id = escape.id()](Scheme& scm, const SymenvPtr&, const varg& args) -> Cell {
+        scm.unwind(id, args)
+            || (void(throw std::invalid_argument("continuation - called outside of its dynamic extent")), 0);
         return none;
     };
-
+    varg result;
     try {
-        return pscm::apply(scm, senv, args.at(0), scm.function(senv, std::move(lambda)));
-    } catch (const continuation_exception& e) {
-        return e.continuation;
+        Cell cont = Function::create(scm.symbol("continuation"), std::move(lambda), scm.memory_resource());
+        Cell val = escape_apply(scm, senv, args.at(0), varg{ cont });
+
+        if (!escape.reached(result))
+            return val;
+
+    } catch (const unwind_exception&) {
+        if (!escape.reached(result))
+            throw;
     }
+    return result.empty() ? none : scm.values(result);
 }
 
+/**
+ * Call with values.
+ *
+ * (call-with-values <producer> <consumer>)
+ *
+ * Apply the consumer to the values of the producer. Multiple values are passed
+ * from the value buffer of the interpreter, without any intermediate list.
+ */
 static Cell callwval(Scheme& scm, const SymenvPtr& senv, const varg& args)
 {
-    struct callwval_exception : std::exception {
-        callwval_exception(Scheme& scm, const SymenvPtr& senv, varg args = varg{})
-            : senv{ senv }
-            , args{ std::move(args) }
-        {
-            auto values = [this](Scheme& scm, const SymenvPtr&, const varg& args) -> Cell {
-                if (this->args.empty())
-                    throw callwval_exception{ scm, this->senv, args };
-                return primop::list(scm, args);
-            };
-            scm.function(senv, "values", std::move(values));
-        }
-        SymenvPtr senv;
-        varg args;
-    };
+    const Cell& consumer = args.at(1);
+    Cell val = primop::apply(scm, senv, args.at(0));
 
-    try {
-        callwval_exception exc{ scm, senv };
-        return primop::apply(scm, senv, args.at(0));
-    } catch (const callwval_exception& e) {
-        return primop::apply(scm, senv, args.at(1), e.args);
-    }
+    if (!is_values(val))
+        return pscm::is_proc(consumer) ? pscm::apply(scm, senv, consumer, val)
+                                       : primop::apply(scm, senv, consumer, varg{ val });
+
+    // A procedure copies its arguments before the evaluation of its body, but a
+    // function might call values itself and requires a copy of the value buffer:
+    return pscm::is_proc(consumer) ? primop::apply(scm, senv, consumer, scm.values())
+                                   : primop::apply(scm, senv, consumer, varg(scm.values()));
 }
 
-struct scheme_exception : std::exception {
-    scheme_exception(Scheme& scm, SymenvPtr senv, varg args)
-        : senv{ std::move(senv) }
-        , args{ std::move(args) }
+//! Exception of a raised object without an active exception handler.
+struct scheme_exception : std::runtime_error {
+    scheme_exception(const Cell& obj, const std::string& msg)
+        : std::runtime_error{ msg }
+        , obj{ obj }
     {
-        auto raise = [](Scheme& scm, const SymenvPtr& senv, const varg& args) -> Cell {
-            if (args.size() != 1)
-                throw std::invalid_argument("raise requires exact one argument");
-
-            throw scheme_exception{ scm, senv, args };
-            return none;
-        };
-        auto raisecont = [this](Scheme& scm, const SymenvPtr& senv, const varg& args) -> Cell {
-            if (args.size() != 1)
-                throw std::invalid_argument("raise requires exact one argument");
-
-            auto& proc = get<Procedure>(this->args.at(0));
-            return primop::apply(scm, senv, proc, args);
-        };
-        auto error = [](Scheme& scm, const SymenvPtr& senv, const varg& args) -> Cell {
-            if (args.size() < 2)
-                throw std::invalid_argument("error requires at least two arguments");
-
-            if (!is_string(args[0]))
-                throw std::invalid_argument("error requires a message string as first argument");
-
-            throw scheme_exception{ scm, senv, args };
-            return none;
-        };
-        auto is_errobj = [](Scheme&, const SymenvPtr&, const varg& args) -> Cell {
-            return is_pair(args.at(0)) && is_string(car(args[0])) && is_pair(cdr(args[0]));
-        };
-        auto errmsg = [is_errobj](Scheme& scm, const SymenvPtr& env, const varg& args) -> Cell {
-            if (!get<Bool>(is_errobj(scm, env, args)))
-                throw std::invalid_argument("argument is not an error object");
-
-            return car(args[0]);
-        };
-        auto errirr = [is_errobj](Scheme& scm, const SymenvPtr& env, const varg& args) -> Cell {
-            if (!get<Bool>(is_errobj(scm, env, args)))
-                throw std::invalid_argument("argument is not an error object");
-            return cdr(args[0]);
-        };
-        // clang-format off
-        scm.function(senv, "raise",                  std::move(raise));
-        scm.function(senv, "raise-continuable",      std::move(raisecont));
-        scm.function(senv, "error",                  std::move(error));
-        scm.function(senv, "error-object?",          std::move(is_errobj));
-        scm.function(senv, "error-object-message",   std::move(errmsg));
-        scm.function(senv, "error-object-irritants", std::move(errirr));
-        // clang-format on
     }
-    Cell apply(Scheme& scm, const SymenvPtr&, const Cell& proc) const
-    {
-        // handle exception by (error <msg> <obj0> [<obj1> ...])
-        return args.size() != 1 ? primop::apply(scm, this->senv, proc, varg{ primop::list(scm, args) })
-                                // handle exception by (raise obj)
-                                : primop::apply(scm, this->senv, proc, args);
-    }
-    SymenvPtr senv;
-    varg args;
+    Cell obj;
 };
+
 /**
  * Scheme function @em with-exception-handler
  * (with-exception-handler <handler> <thunk>)
  * (handler <obj>)
  *
+ * Install the handler on the exception handler stack of the interpreter for the
+ * extent of the thunk call. A raise or error call unwinds to the innermost
+ * handler, which is called outside of its own extent.
+ *
  * Example:
  * @verbatim
  * (with-exception-handler ...
@@ -636,24 +614,105 @@ struct scheme_exception : std::exception {
  */
 static Cell withexcept(Scheme& scm, const SymenvPtr& senv, const varg& args)
 {
+    const Cell& handler = args.at(0);
+    varg result;
     try {
-        scheme_exception exc{ scm, senv, args };
-        return primop::apply(scm, senv, args.at(1));
+        Scheme::Escape escape{ scm, handler };
+        try {
+            Cell val = escape_apply(scm, senv, args.at(1), varg{});
 
+            if (!escape.reached(result))
+                return val;
+
+        } catch (const unwind_exception&) {
+            if (!escape.reached(result))
+                throw;
+        }
     } catch (const scheme_exception& e) {
-        return e.apply(scm, senv, args.at(0));
+        // object raised without an active handler of its own, as inside a resumed coroutine
+        return primop::apply(scm, senv, handler, varg{ e.obj });
+
+    } catch (const memory_exhausted& e) {
+        // handle as (error "out of memory" <limit>), allocated from the budget reserve
+        Cell obj = primop::list(scm, varg{ scm.str("out of memory"), Number{ static_cast<Int>(e.limit) } });
+        return primop::apply(scm, senv, handler, varg{ obj });
+
+    } catch (const depth_exceeded& e) {
+        // handle as (error "recursion depth exceeded" <limit>)
+        Cell obj = primop::list(scm, varg{ scm.str("recursion depth exceeded"), Number{ static_cast<Int>(e.limit) } });
+        return primop::apply(scm, senv, handler, varg{ obj });
+
+    } catch (const budget_exhausted& e) {
+        // handle as (error "evaluation fuel exhausted") or (error "evaluation deadline exceeded")
+        Cell obj = primop::list(scm, varg{ scm.str(e.what()) });
+        return primop::apply(scm, senv, handler, varg{ obj });
     }
+    return primop::apply(scm, senv, handler, result);
 }
 
-static Cell error(Scheme& scm, const SymenvPtr& senv, const varg& args)
+//! Scheme function @em raise
+static Cell raise(Scheme& scm, const varg& args)
+{
+    if (args.size() != 1)
+        throw std::invalid_argument("raise requires exact one argument");
+
+    if (!scm.raise(args))
+        throw scheme_exception{ args[0], "raise - no exception handler" };
+    return none;
+}
+
+//! Scheme function @em raise-continuable
+static Cell raisecont(Scheme& scm, const SymenvPtr& senv, const varg& args)
+{
+    if (args.size() != 1)
+        throw std::invalid_argument("raise requires exact one argument");
+
+    Cell result;
+    if (!scm.raise_continuable(senv, args[0], result))
+        throw scheme_exception{ args[0], "raise-continuable - no exception handler" };
+
+    return result;
+}
+
+/**
+ * Scheme function @em error
+ * (error <message> <obj> ...)
+ *
+ * Raise an error object, which is the list of the message string and the irritants.
+ */
+static Cell error(Scheme& scm, const varg& args)
 {
     if (args.size() < 2 || !is_string(args[0]))
         throw std::invalid_argument("invalid number of arguments or not a message string");
 
-    throw scheme_exception{ scm, senv, args };
+    Cell obj = primop::list(scm, args);
+
+    if (!scm.raise(varg{ obj }))
+        throw scheme_exception{ obj, string_convert<char>(*get<StringPtr>(args[0])) };
     return none;
 }
 
+static Cell is_errobj(const varg& args)
+{
+    return is_pair(args.at(0)) && is_string(car(args[0])) && is_pair(cdr(args[0]));
+}
+
+static Cell errobjmsg(const varg& args)
+{
+    if (!get<Bool>(is_errobj(args)))
+        throw std::invalid_argument("argument is not an error object");
+
+    return car(args[0]);
+}
+
+static Cell errobjirr(const varg& args)
+{
+    if (!get<Bool>(is_errobj(args)))
+        throw std::invalid_argument("argument is not an error object");
+
+    return cdr(args[0]);
+}
+
 /**
  * Scheme list @em member function.
  */
@@ -677,7 +736,7 @@ static Cell memq(const SymenvPtr&, const varg& args)
  *
  * (member obj list [compare])
  */
-static Cell member(Scheme scm, const SymenvPtr& senv, const varg& args)
+static Cell member(Scheme& scm, const SymenvPtr& senv, const varg& args)
 {
     Cell list = args.at(1);
     const Cell& obj = args.front();
@@ -945,7 +1004,7 @@ static Cell digitval(const varg& args)
  * Scheme @em make-string function.
  * (make-string len [char])
  */
-static Cell mkstring(const varg& args)
+static Cell mkstring(Scheme& scm, const varg& args)
 {
     Int size = get<Int>(get<Number>(args.at(0)));
     size >= 0 || ((void)(throw std::invalid_argument("invalid negative number")), 0);
@@ -954,15 +1013,15 @@ static Cell mkstring(const varg& args)
     if (args.size() > 1)
         c = get<Char>(args[1]);
 
-    return std::make_shared<StringPtr::element_type>(size, c);
+    return scm.str(size, c);
 }
 
 /**
  * Scheme string function.
  */
-static Cell string(const varg& args)
+static Cell string(Scheme& scm, const varg& args)
 {
-    StringPtr pstr = std::make_shared<StringPtr::element_type>();
+    StringPtr pstr = scm.str();
     pstr->reserve(args.size());
 
     for (auto& cell : args)
@@ -1000,11 +1059,11 @@ static Cell strlist(Scheme& scm, const varg& args)
 /**
  * Scheme list->string function.
  */
-static Cell liststr(const varg& args)
+static Cell liststr(Scheme& scm, const varg& args)
 {
     Cell list = args.at(0);
 
-    auto pstr = std::make_shared<StringPtr::element_type>();
+    auto pstr = scm.str();
 
     if (is_nil(list))
         return pstr;
@@ -1222,9 +1281,9 @@ static Cell isstrcige(const varg& args)
 /**
  * Scheme @em string-upcase function.
  */
-static Cell strupcase(const varg& args)
+static Cell strupcase(Scheme& scm, const varg& args)
 {
-    auto sptr = std::make_shared<StringPtr::element_type>(*get<StringPtr>(args.at(0)));
+    auto sptr = scm.str(*get<StringPtr>(args.at(0)));
     std::transform(sptr->begin(), sptr->end(), sptr->begin(), ::toupper);
     return sptr;
 }
@@ -1232,9 +1291,9 @@ static Cell strupcase(const varg& args)
 /**
  * Scheme @em string-upcase function.
  */
-static Cell strdowncase(const varg& args)
+static Cell strdowncase(Scheme& scm, const varg& args)
 {
-    auto sptr = std::make_shared<StringPtr::element_type>(*get<StringPtr>(args.at(0)));
+    auto sptr = scm.str(*get<StringPtr>(args.at(0)));
     std::transform(sptr->begin(), sptr->end(), sptr->begin(), ::tolower);
     return sptr;
 }
@@ -1262,12 +1321,12 @@ static Cell strdowncaseb(const varg& args)
 /**
  * Scheme @em string-append function.
  */
-static Cell strappend(const varg& args)
+static Cell strappend(Scheme& scm, const varg& args)
 {
     if (args.empty())
-        return std::make_shared<StringPtr::element_type>();
+        return scm.str();
 
-    auto pstr = std::make_shared<StringPtr::element_type>(*get<StringPtr>(args.at(0)));
+    auto pstr = scm.str(*get<StringPtr>(args.at(0)));
 
     for (auto ip = args.begin() + 1, ie = args.end(); ip != ie; ++ip)
         pstr->append(*get<StringPtr>(*ip));
@@ -1291,7 +1350,7 @@ static Cell strappendb(const varg& args)
 /**
  * Scheme string-copy function.
  */
-static Cell strcopy(const varg& args)
+static Cell strcopy(Scheme& scm, const varg& args)
 {
     const auto& pstr = get<StringPtr>(args.at(0));
 
@@ -1306,7 +1365,7 @@ static Cell strcopy(const varg& args)
     if (args.size() > 1)
         pos = std::min(get<Int>(get<Number>(args[1])), end);
 
-    return std::make_shared<StringPtr::element_type>(pstr->substr(pos, end - pos));
+    return scm.str(*pstr, pos, end - pos);
 }
 
 /**
@@ -1363,13 +1422,13 @@ static Cell strfillb(const varg& args)
     return pstr;
 }
 
-static Cell make_vector(const varg& args)
+static Cell make_vector(Scheme& scm, const varg& args)
 {
     auto size = get<Int>(get<Number>(args.at(0)));
     size >= 0 || ((void)(throw std::invalid_argument("vector length must be a non-negative integer")), 0);
 
     Cell val{ args.size() > 1 ? args[1] : none };
-    return pscm::vec(size, val);
+    return scm.vec(static_cast<size_t>(size), val);
 }
 
 /**
@@ -1399,10 +1458,10 @@ static Cell vector_setb(const varg& args)
  * Scheme @em list->vector function.
  * @verbatim (list->vector '(x0 x1 x2 ... xn)) => #(x0 x1 x2 ... xn) @endverbatim
  */
-static Cell list2vec(const varg& args)
+static Cell list2vec(Scheme& scm, const varg& args)
 {
     Cell list = args.at(0);
-    VectorPtr v = std::make_shared<VectorPtr::element_type>();
+    VectorPtr v = scm.vec();
 
     for (/* */; is_pair(list); list = cdr(list))
         v->push_back(car(list));
@@ -1442,7 +1501,7 @@ static Cell vec2list(Scheme& scm, const varg& args)
  * Scheme @em vector-copy function.
  * @verbatim (vector-copy #(x0 x1 x2 ... xn) [pos [end]]) => #(x0 x1 x2 ... xn) @endverbatim
  */
-static Cell vec_copy(const varg& args)
+static Cell vec_copy(Scheme& scm, const varg& args)
 {
     using size_type = VectorPtr::element_type::difference_type;
 
@@ -1454,8 +1513,8 @@ static Cell vec_copy(const varg& args)
     if (args.size() > 1)
         pos = std::min(static_cast<size_type>(get<Int>(get<Number>(args[1]))), end);
 
-    return pos != end ? std::make_shared<VectorPtr::element_type>(v->begin() + pos, v->begin() + end)
-                      : std::make_shared<VectorPtr::element_type>(0);
+    return pos != end ? scm.vec(v->begin() + pos, v->begin() + end)
+                      : scm.vec();
 }
 
 /**
@@ -1507,9 +1566,9 @@ static Cell vec_fillb(const varg& args)
  * Scheme @em vector-append function.
  * @verbatim (vector-append vec_0 vec_1 ... vec_n) => vec := {vec_0, vec_1, ..., vec_n} @endverbatim
  */
-static Cell vec_append(const varg& args)
+static Cell vec_append(Scheme& scm, const varg& args)
 {
-    auto vptr = std::make_shared<VectorPtr::element_type>(*get<VectorPtr>(args.at(0)));
+    auto vptr = scm.vec(*get<VectorPtr>(args.at(0)));
 
     for (auto ip = begin(args) + 1, ie = end(args); ip != ie; ++ip)
         if (is_vector(*ip)) {
@@ -1553,10 +1612,10 @@ static Cell callw_port(Scheme& scm, const SymenvPtr& senv, const PortPtr& port,
     return cell;
 }
 
-static Cell open_infile(const String& filnam)
+static Cell open_infile(Scheme& scm, const String& filnam)
 {
     using port_type = FilePort<Char>;
-    auto port = std::make_shared<port_type>(filnam, port_type::in);
+    auto port = scm.make_shared<port_type>(filnam, port_type::in);
 
     if (!port->is_open())
         throw std::ios_base::failure("couldn't open input file: '"s
@@ -1572,7 +1631,7 @@ static Cell open_infile(const String& filnam)
  *
  * Default file open mode is to clear the content of an existing file.
  */
-static Cell open_outfile(const varg& args)
+static Cell open_outfile(Scheme& scm, const varg& args)
 {
     using port_type = FilePort<Char>;
     port_type::openmode mode = port_type::out;
@@ -1581,7 +1640,7 @@ static Cell open_outfile(const varg& args)
         mode |= port_type::app;
 
     auto& filnam = *get<StringPtr>(args.at(0));
-    auto port = std::make_shared<port_type>(filnam, mode);
+    auto port = scm.make_shared<port_type>(filnam, mode);
 
     if (!port->is_open())
         throw std::ios_base::failure("couldn't open output file: '"s
@@ -1616,7 +1675,7 @@ static Cell close_outport(Port<Char>& port)
 static Cell callw_infile(Scheme& scm, const SymenvPtr& senv, const String& filnam, const Cell& proc)
 {
     using port_type = FilePort<Char>;
-    auto port = std::make_shared<port_type>(filnam, port_type::in);
+    auto port = scm.make_shared<port_type>(filnam, port_type::in);
 
     if (!port->is_open())
         throw port_type::stream_type::failure("couldn't open input file: '"s
@@ -1632,7 +1691,7 @@ static Cell callw_infile(Scheme& scm, const SymenvPtr& senv, const String& filna
 static Cell callw_outfile(Scheme& scm, const SymenvPtr& senv, const String& filnam, const Cell& proc)
 {
     using port_type = FilePort<Char>;
-    auto port = std::make_shared<port_type>(filnam, port_type::out);
+    auto port = scm.make_shared<port_type>(filnam, port_type::out);
 
     if (!port->is_open())
         throw std::ios_base::failure("couldn't open output file: '"s
@@ -1836,7 +1895,7 @@ static Cell readline(Scheme& scm, const varg& args)
             throw input_port_exception(port);
         }
     }
-    return std::make_shared<String>(std::move(str));
+    return scm.str(std::move(str));
 }
 
 /**
@@ -1872,19 +1931,113 @@ static Cell read_str(Scheme& scm, const varg& args)
     }
     str.resize(len);
     str.shrink_to_fit();
-    return std::make_shared<String>(std::move(str));
+    return scm.str(std::move(str));
 }
 
 static Cell gcollect(Scheme& scm, const SymenvPtr& senv, const varg& args)
 {
-    GCollector gc;
     bool logok = args.size() > 0 ? get<Bool>(args[0]) : false;
 
-    gc.logging(logok);
-    gc.collect(scm, senv);
+    // the interpreter collector counts the cycles, which invalidate reused rest parameter lists
+    scm.gc.logging(logok);
+    scm.gc.collect(scm, senv);
+    scm.gc.logging(false);
     return none;
 }
 
+//! Return the optimiser state and optionally enable or disable the optimiser.
+static Cell optimize(Scheme& scm, const varg& args)
+{
+    bool state = scm.optimizer.enabled();
+
+    if (args.size() > 0)
+        scm.optimizer.enable(get<Bool>(args[0]));
+
+    return state;
+}
+
+//! Return the state of the numeric procedure compiler and optionally enable or disable it.
+static Cell compile(Scheme& scm, const varg& args)
+{
+    bool state = scm.compiler.enabled();
+
+    if (args.size() > 0)
+        scm.compiler.enable(get<Bool>(args[0]));
+
+    return state;
+}
+
+//! Return the nesting depth limit of evaluations and optionally set a new limit.
+static Cell depth_limit(Scheme& scm, const varg& args)
+{
+    Int limit = static_cast<Int>(scm.depth_limit());
+
+    if (args.size() > 0) {
+        Int arg = get<Int>(get<Number>(args[0]));
+        arg > 0 || (void(throw std::invalid_argument("depth-limit - positive integer required")), 0);
+        scm.depth_limit(static_cast<size_t>(arg));
+    }
+    return Number{ limit };
+}
+
+/**
+ * Scheme function @em eval-budget
+ * (eval-budget [<fuel> [<milliseconds>]])
+ *
+ * Return the remaining fuel of the current evaluation or #f, if unlimited and
+ * optionally set a new execution budget for this and each following top-level
+ * evaluation. A zero fuel or time value disables the corresponding limit.
+ */
+static Cell eval_budget(Scheme& scm, const varg& args)
+{
+    size_t fuel = scm.eval_fuel();
+
+    if (args.size() > 0) {
+        Int arg = get<Int>(get<Number>(args[0])),
+            ms = args.size() > 1 ? get<Int>(get<Number>(args[1])) : 0;
+
+        (arg >= 0 && ms >= 0) || (void(throw std::invalid_argument("eval-budget - non-negative integer required")), 0);
+        scm.eval_budget(static_cast<size_t>(arg), std::chrono::milliseconds{ ms });
+    }
+    return fuel ? Cell{ Number{ static_cast<Int>(fuel) } } : Cell{ false };
+}
+
+/**
+ * Scheme function @em memory-budget
+ * (memory-budget [<bytes>])
+ *
+ * Return the number of bytes currently allocated from the interpreter memory
+ * resource and optionally set a new byte limit of the memory budget. A zero
+ * byte limit disables the limit.
+ */
+static Cell memory_budget(Scheme& scm, const varg& args)
+{
+    Int used = static_cast<Int>(scm.memory_budget().used());
+
+    if (args.size() > 0) {
+        Int arg = get<Int>(get<Number>(args[0]));
+        arg >= 0 || (void(throw std::invalid_argument("memory-budget - non-negative integer required")), 0);
+        scm.memory_budget().limit(arg ? static_cast<size_t>(arg) : MemoryBudget::unlimited);
+    }
+    return Number{ used };
+}
+
+/**
+ * Scheme function @em frame-pool
+ * (frame-pool [<release?>])
+ *
+ * Return the number of live call frames of the leaf procedure frame pool. If the
+ * optional argument is true, hand all pooled memory back to the interpreter memory
+ * resource instead and return false, if a live call frame prevents the release.
+ */
+static Cell frame_pool(Scheme& scm, const varg& args)
+{
+    if (args.size() > 0 && is_true(args[0]))
+        return scm.frame_pool().release();
+
+    return Number{ static_cast<Int>(scm.frame_pool().live()) };
+}
+
 static Cell gcdump(Scheme& scm, const varg& args)
 {
     auto port = args.size() > 0 ? get<PortPtr>(args[0])
@@ -1905,7 +2058,91 @@ static Cell macroexp(Scheme& scm, const SymenvPtr& senv, const varg& args)
     if (!is_macro(proc))
         return expr;
 
-    return get<Procedure>(proc).expand(scm, expr);
+    return get<Procedure>(proc).expand(scm, senv, expr);
+}
+
+/**
+ * Scheme @em expand-file function.
+ *
+ * (expand-file <filename>)
+ *
+ * Read all expressions of a file without evaluating them and return a list of
+ * the expressions, where all macro calls are expanded in place. Only the top-level
+ * define-macro and define-syntax expressions of the file are evaluated, as by load,
+ * so that the following expressions expand the macros, which the file defines itself.
+ */
+static Cell expand_file(Scheme& scm, const SymenvPtr& senv, const varg& args)
+{
+    using port_type = FilePort<Char>;
+    auto& filnam = *get<StringPtr>(args.at(0));
+    port_type in{ filnam, port_type::in };
+
+    if (!in.is_open())
+        throw std::ios_base::failure("couldn't open input file: '"s
+            + string_convert<char>(filnam) + "'"s);
+
+    Parser parser{ scm };
+    Cell head = nil, tail = nil;
+
+    while (!in.eof()) {
+        Cell expr = parser.read(in);
+
+        if (is_char(expr) && get<Char>(expr) == static_cast<Char>(EOF))
+            break;
+
+        expr = scm.expand_all(senv, expr);
+
+        if (is_pair(expr) && is_symbol(car(expr)))
+            if (const Cell* val = senv->find(get<Symbol>(car(expr))); val && is_intern(*val)
+                && (get<Intern>(*val) == Intern::_macro || get<Intern>(*val) == Intern::_define_syntax))
+                scm.eval(senv, expr);
+
+        Cell cons = scm.cons(expr, nil);
+        is_nil(tail) ? void(head = cons) : set_cdr(tail, cons);
+        tail = cons;
+    }
+    return head;
+}
+
+static Cell translate_file(Scheme& scm, const varg& args)
+{
+    args.size() == 3 || (void(throw std::invalid_argument("translate-file - invalid number of arguments")), 0);
+
+    auto& outnam = *get<StringPtr>(args[1]);
+    std::ofstream out{ string_convert<char>(outnam) };
+
+    if (!out.is_open())
+        throw std::ios_base::failure("couldn't open output file: '"s
+            + string_convert<char>(outnam) + "'"s);
+
+    Translator{ scm }.translate(*get<StringPtr>(args[0]), out, string_convert<char>(*get<StringPtr>(args[2])));
+    return none;
+}
+
+/**
+ * Scheme @em file-exists? predicate.
+ *
+ * (file-exists? <filename>)
+ */
+static Cell file_exists(const varg& args)
+{
+    return std::ifstream{ string_convert<char>(*get<StringPtr>(args.at(0))) }.is_open();
+}
+
+/**
+ * Scheme @em delete-file function.
+ *
+ * (delete-file <filename>)
+ */
+static Cell delete_file(const varg& args)
+{
+    auto& filnam = *get<StringPtr>(args.at(0));
+
+    if (std::remove(string_convert<char>(filnam).c_str()))
+        throw std::ios_base::failure("couldn't delete file: '"s
+            + string_convert<char>(filnam) + "'"s);
+
+    return none;
 }
 
 static Cell for_each(Scheme& scm, const SymenvPtr& senv, const varg& args)
@@ -1996,13 +2233,13 @@ static Cell map(Scheme& scm, const SymenvPtr& senv, const varg& args)
  * @throws a std::regex_error exception if the supplied regular expression
  *         string is invalid
  */
-static Cell regex(Scheme&, const varg& args)
+static Cell regex(Scheme& scm, const varg& args)
 {
     using regex = RegexPtr::element_type;
     auto& pstr = get<StringPtr>(args.at(0));
 
     regex::flag_type flags = regex::ECMAScript | regex::icase;
-    return std::make_shared<RegexPtr::element_type>(*pstr, flags);
+    return scm.make_shared<RegexPtr::element_type>(*pstr, flags);
 }
 
 /**
@@ -2015,10 +2252,9 @@ static Cell regex(Scheme&, const varg& args)
  *                matched string and all possible submatches or false otherwise.
  * @return false if no match exists, true or vector otherwise.
  */
-static Cell regex_match(const varg& args)
+static Cell regex_match(Scheme& scm, const varg& args)
 {
     using string = StringPtr::element_type;
-    using vector = VectorPtr::element_type;
 
     auto& pregex = get<RegexPtr>(args.at(0));
     auto& pstr = get<StringPtr>(args.at(1));
@@ -2030,11 +2266,11 @@ static Cell regex_match(const varg& args)
 
         if (std::regex_match(*pstr, smatch, *pregex)) {
 
-            auto vres{ std::make_shared<vector>() };
+            auto vres{ scm.vec() };
             vres->reserve(smatch.size());
 
             for (auto& m : smatch)
-                vres->push_back(pscm::str(m.str()));
+                vres->push_back(scm.str(m.str()));
 
             return vres;
         } else
@@ -2052,20 +2288,19 @@ static Cell regex_match(const varg& args)
  * @param args[1] String to match
  * @return false if no match exists, or a vector of found submatches otherwise.
  */
-static Cell regex_search(const varg& args)
+static Cell regex_search(Scheme& scm, const varg& args)
 {
     using string = StringPtr::element_type;
-    using vector = VectorPtr::element_type;
 
     auto& pregex = get<RegexPtr>(args.at(0));
     auto str{ *get<StringPtr>(args.at(1)) };
 
     std::match_results<string::const_iterator> smatch;
-    auto vres{ std::make_shared<vector>(0) };
+    auto vres{ scm.vec() };
 
     while (std::regex_search(str, smatch, *pregex)) {
-        vres->push_back(pscm::str(smatch.str()));
-        str = smatch.suffix();
+        vres->push_back(scm.str(smatch.str()));
+        str.erase(0, static_cast<size_t>(smatch.position() + smatch.length()));
     }
     return vres->size() ? Cell{ vres } : Cell{ false };
 }
@@ -2075,9 +2310,9 @@ static Cell regex_search(const varg& args)
 static Cell make_dict(Scheme& scm, const SymenvPtr& env, const varg& args)
 {
     if (args.empty())
-        return std::make_shared<MapPtr::element_type>();
+        return scm.dict();
 
-    return std::make_shared<MapPtr::element_type>(pscm::less<Cell>(scm, env, args[0]));
+    return scm.dict(pscm::less<Cell>(scm, env, args[0]));
 }
 
 static Cell dict_insert(const varg& args)
@@ -2097,7 +2332,7 @@ static Cell dict_find(const varg& args)
 }
 
 //! Return a scheme vector of all values in dict equal to key or false if none.
-static Cell dict_equal_range(const varg& args)
+static Cell dict_equal_range(Scheme& scm, const varg& args)
 {
     auto& dict = *get<MapPtr>(args.at(0));
     auto [pos, end] = dict.equal_range(args.at(1));
@@ -2105,7 +2340,7 @@ static Cell dict_equal_range(const varg& args)
     if (pos == end)
         return false;
 
-    auto res = std::make_shared<VectorPtr::element_type>();
+    auto res = scm.vec();
     for (/* */; pos != end; ++pos)
         res->push_back(pos->second);
     return res;
@@ -2129,9 +2364,9 @@ static Cell dict2list(Scheme& scm, const varg& args)
 }
 
 //! Convert a association list into a dictionary.
-static Cell list2dict(const varg& args)
+static Cell list2dict(Scheme& scm, const varg& args)
 {
-    auto dict = std::make_shared<MapPtr::element_type>();
+    auto dict = scm.dict();
 
     for (Cell iter = args.at(0); is_pair(iter); iter = cdr(iter))
         dict->insert(std::make_pair(caar(iter), cdar(iter)));
@@ -2140,10 +2375,118 @@ static Cell list2dict(const varg& args)
 }
 #endif
 
+/**
+ * Scheme function @em make-coroutine
+ * (make-coroutine <procedure>)
+ *
+ * Return a function, which resumes the coroutine of the procedure without arguments
+ * with an optional argument value as result of its pending yield call.
+ */
+static Cell make_coroutine(Scheme& scm, const SymenvPtr& senv, const varg& args)
+{
+    const Cell& proc = args.at(0);
+    pscm::is_proc(proc) || is_func(proc) || is_intern(proc)
+        || (void(throw std::invalid_argument("make-coroutine - not a procedure")), 0);
+
+    return Function::create(scm.symbol("coroutine"), Coroutine::Resume{ scm.make_shared<Coroutine>(scm, senv, proc) }, scm.memory_resource());
+}
+
+/**
+ * Scheme function @em close-coroutine
+ * (close-coroutine <coroutine>)
+ *
+ * Finish a coroutine without resuming it and drop its suspended procedure
+ * evaluation. Any further resume call returns the eof-object.
+ */
+static Cell close_coroutine(const varg& args)
+{
+    const Coroutine::Resume* resume = is_func(args.at(0)) ? get<FunctionPtr>(args[0])->target<Coroutine::Resume>() : nullptr;
+    resume || (void(throw std::invalid_argument("close-coroutine - not a coroutine")), 0);
+
+    resume->coroutine->close();
+    return none;
+}
+
+/**
+ * Scheme function @em spawn
+ * (spawn <procedure>)
+ *
+ * Start a new green thread of the procedure without arguments.
+ */
+static Cell spawn(Scheme& scm, const SymenvPtr& senv, const varg& args)
+{
+    const Cell& proc = args.at(0);
+    pscm::is_proc(proc) || is_func(proc) || is_intern(proc)
+        || (void(throw std::invalid_argument("spawn - not a procedure")), 0);
+
+    scm.scheduler.spawn(senv, proc);
+    return none;
+}
+
+//! Scheme function @em sleep (sleep <milliseconds>)
+static Cell sleep(Scheme& scm, const varg& args)
+{
+    Int ms = get<Int>(get<Number>(args.at(0)));
+    ms >= 0 || (void(throw std::invalid_argument("sleep - negative duration")), 0);
+
+    scm.scheduler.sleep(std::chrono::milliseconds{ ms });
+    return none;
+}
+
+/**
+ * Scheme function @em make-channel
+ * (make-channel)
+ *
+ * Return a new channel function, which removes and returns the first
+ * channel message, if called without argument and appends its argument
+ * to the channel messages otherwise.
+ */
+static Cell make_channel(Scheme& scm)
+{
+    return Function::create(scm.symbol("channel"), Scheduler::Endpoint{ scm.scheduler.channel() }, scm.memory_resource());
+}
+
+/**
+ * Scheme functions @em channel-send and @em channel-receive
+ * (channel-send <channel> <obj>)
+ * (channel-receive <channel>)
+ */
+static Cell channel(Scheme& scm, const SymenvPtr& senv, const varg& args)
+{
+    const Scheduler::Endpoint* chan = is_func(args.at(0)) ? get<FunctionPtr>(args[0])->target<Scheduler::Endpoint>() : nullptr;
+    chan || (void(throw std::invalid_argument("channel - not a channel")), 0);
+
+    return (*chan)(scm, senv, varg{ args.begin() + 1, args.end() });
+}
+
 } // namespace pscm::primop
 
 namespace pscm {
 
+bool is_environment_primop(Intern primop)
+{
+    switch (primop) {
+    case Intern::op_callcc:
+    case Intern::op_eval:
+    case Intern::op_replenv:
+    case Intern::op_repl:
+    case Intern::op_load:
+    case Intern::op_expand_file:
+    case Intern::op_macroexp:
+    case Intern::_define_record_type:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_pure_primop(Intern primop)
+{
+    return (primop >= Intern::op_eq && primop <= Intern::op_hypot)
+        || (primop >= Intern::op_not && primop <= Intern::op_isbooleq)
+        || (primop >= Intern::op_ischar && primop <= Intern::op_foldcase);
+}
+
 Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
 {
     switch (primop) {
@@ -2280,7 +2623,7 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_strnum:
         return Parser::strnum(*get<StringPtr>(args.at(0)));
     case Intern::op_numstr:
-        return primop::numstr(args);
+        return primop::numstr(scm, args);
 
     /* Section 6.3: Booleans */
     case Intern::op_not:
@@ -2352,7 +2695,7 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_issym:
         return is_symbol(args.at(0));
     case Intern::op_symstr:
-        return std::make_shared<StringPtr::element_type>(get<Symbol>(args.at(0)).value());
+        return scm.str(get<Symbol>(args.at(0)).value());
     case Intern::op_strsym:
         return scm.symbol(get<StringPtr>(args.at(0))->c_str());
     case Intern::op_gensym:
@@ -2406,11 +2749,11 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_isstr:
         return is_type<StringPtr>(args.at(0));
     case Intern::op_mkstr:
-        return primop::mkstring(args);
+        return primop::mkstring(scm, args);
     case Intern::op_str:
-        return primop::string(args);
+        return primop::string(scm, args);
     case Intern::op_strappend:
-        return primop::strappend(args);
+        return primop::strappend(scm, args);
     case Intern::op_strappendb:
         return primop::strappendb(args);
     case Intern::op_strlen:
@@ -2441,17 +2784,17 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_isstrcige:
         return primop::isstrcige(args);
     case Intern::op_strupcase:
-        return primop::strupcase(args);
+        return primop::strupcase(scm, args);
     case Intern::op_strdowncase:
-        return primop::strdowncase(args);
+        return primop::strdowncase(scm, args);
     case Intern::op_strupcaseb:
         return primop::strupcaseb(args);
     case Intern::op_strdowncaseb:
         return primop::strdowncaseb(args);
     case Intern::op_substr:
-        return primop::strcopy(args);
+        return primop::strcopy(scm, args);
     case Intern::op_strcopy:
-        return primop::strcopy(args);
+        return primop::strcopy(scm, args);
     case Intern::op_strcopyb:
         return primop::strcopyb(args);
     case Intern::op_strfillb:
@@ -2459,15 +2802,15 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_strlist:
         return primop::strlist(scm, args);
     case Intern::op_liststr:
-        return primop::liststr(args);
+        return primop::liststr(scm, args);
 
     /* Section 6.8: Vectors */
     case Intern::op_isvec:
         return is_type<VectorPtr>(args.at(0));
     case Intern::op_mkvec:
-        return primop::make_vector(args);
+        return primop::make_vector(scm, args);
     case Intern::op_vec:
-        return std::make_shared<VectorPtr::element_type>(args);
+        return scm.vec(args.begin(), args.end());
     case Intern::op_veclen:
         return Number{ get<VectorPtr>(args.at(0))->size() };
     case Intern::op_vecref:
@@ -2477,13 +2820,13 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_veclist:
         return primop::vec2list(scm, args);
     case Intern::op_listvec:
-        return primop::list2vec(args);
+        return primop::list2vec(scm, args);
     case Intern::op_veccopy:
-        return primop::vec_copy(args);
+        return primop::vec_copy(scm, args);
     case Intern::op_veccopyb:
         return primop::vec_copyb(args);
     case Intern::op_vecappend:
-        return primop::vec_append(args);
+        return primop::vec_append(scm, args);
     case Intern::op_vecappendb:
         return primop::vec_appendb(args);
     case Intern::op_vecfillb:
@@ -2496,6 +2839,8 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
         return primop::is_proc(args);
     case Intern::op_callcc:
         return primop::callcc(scm, senv, args);
+    case Intern::op_values:
+        return scm.values(args);
     case Intern::op_callwval:
         return primop::callwval(scm, senv, args);
     case Intern::op_map:
@@ -2505,9 +2850,19 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
 
     /* Section 6.11: Exceptions */
     case Intern::op_error:
-        return primop::error(scm, senv, args);
+        return primop::error(scm, args);
     case Intern::op_with_exception:
         return primop::withexcept(scm, senv, args);
+    case Intern::op_raise:
+        return primop::raise(scm, args);
+    case Intern::op_raisecont:
+        return primop::raisecont(scm, senv, args);
+    case Intern::op_iserrobj:
+        return primop::is_errobj(args);
+    case Intern::op_errobjmsg:
+        return primop::errobjmsg(args);
+    case Intern::op_errobjirr:
+        return primop::errobjirr(args);
     case Intern::op_exit:
         return Intern::op_exit;
 
@@ -2525,6 +2880,18 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
         return primop::gcollect(scm, senv, args);
     case Intern::op_gcdump:
         return primop::gcdump(scm, args);
+    case Intern::op_optimize:
+        return primop::optimize(scm, args);
+    case Intern::op_compile:
+        return primop::compile(scm, args);
+    case Intern::op_depth_limit:
+        return primop::depth_limit(scm, args);
+    case Intern::op_eval_budget:
+        return primop::eval_budget(scm, args);
+    case Intern::op_memory_budget:
+        return primop::memory_budget(scm, args);
+    case Intern::op_frame_pool:
+        return primop::frame_pool(scm, args);
     case Intern::op_macroexp:
         return primop::macroexp(scm, senv, args);
 
@@ -2550,9 +2917,9 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_callw_outfile:
         return primop::callw_outfile(scm, senv, *get<StringPtr>(args.at(0)), args.at(1));
     case Intern::op_open_infile:
-        return primop::open_infile(*get<StringPtr>(args.at(0)));
+        return primop::open_infile(scm, *get<StringPtr>(args.at(0)));
     case Intern::op_open_outfile:
-        return primop::open_outfile(args);
+        return primop::open_outfile(scm, args);
     case Intern::op_close_port:
         return ((void)(get<PortPtr>(args.at(0))->close()), none);
     case Intern::op_close_inport:
@@ -2588,22 +2955,30 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
 
     /* Section 6.14: System interface */
     case Intern::op_load:
-        scm.load(*get<StringPtr>(args.at(0)), senv);
+        scm.load(*get<StringPtr>(args.at(0)), senv, args.size() > 1 && is_true(args[1]));
         return none;
+    case Intern::op_expand_file:
+        return primop::expand_file(scm, senv, args);
+    case Intern::op_translate_file:
+        return primop::translate_file(scm, args);
+    case Intern::op_fileok:
+        return primop::file_exists(args);
+    case Intern::op_delfile:
+        return primop::delete_file(args);
 
 #ifdef PSCM_REGEXPS
     /* Section extensions - Regular expressions */
     case Intern::op_regex:
         return primop::regex(scm, args);
     case Intern::op_regex_match:
-        return primop::regex_match(args);
+        return primop::regex_match(scm, args);
     case Intern::op_regex_search:
-        return primop::regex_search(args);
+        return primop::regex_search(scm, args);
 #endif
 
     /* Section extensions - Date, clock and time measurements */
     case Intern::op_clock:
-        return std::make_shared<Clock>();
+        return scm.make_shared<Clock>();
     case Intern::op_clock_toc:
         return Number{get<ClockPtr>(args.at(0))->toc() };
     case Intern::op_clock_tic:
@@ -2613,6 +2988,27 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_clock_resume:
         return ((void)get<ClockPtr>(args.at(0))->resume(), none);
 
+    case Intern::op_make_coroutine:
+        return primop::make_coroutine(scm, senv, args);
+    case Intern::op_close_coroutine:
+        return primop::close_coroutine(args);
+    case Intern::op_yield:
+        return scm.scheduler.yield(args.empty() ? none : args[0]);
+    case Intern::op_spawn:
+        return primop::spawn(scm, senv, args);
+    case Intern::op_sleep:
+        return primop::sleep(scm, args);
+    case Intern::op_make_channel:
+        return primop::make_channel(scm);
+    case Intern::op_channel_send:
+        args.size() == 2 || (void(throw std::invalid_argument("channel-send - message required")), 0);
+        return primop::channel(scm, senv, args);
+    case Intern::op_channel_receive:
+        args.size() == 1 || (void(throw std::invalid_argument("channel-receive - too many arguments")), 0);
+        return primop::channel(scm, senv, args);
+    case Intern::op_run_threads:
+        scm.scheduler.run();
+        return none;
     case Intern::op_usecount:
         return Number{ use_count(args.at(0)) };
     case Intern::op_hash:
@@ -2621,7 +3017,7 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     /* Section extensions - Dictionary as std::map */
     case Intern::op_make_dict:
         return primop::make_dict(scm, senv, args);
-        //        return std::make_shared<MapPtr::element_type>();
+        //        return scm.dict();
     case Intern::op_dict_isempty:
         return std::get<MapPtr>(args.at(0))->empty();
     case Intern::op_dict_size:
@@ -2637,11 +3033,11 @@ Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const varg& args)
     case Intern::op_dict_find:
         return primop::dict_find(args);
     case Intern::op_dict_equal_range:
-        return primop::dict_equal_range(args);
+        return primop::dict_equal_range(scm, args);
     case Intern::op_dict2list:
         return primop::dict2list(scm, args);
     case Intern::op_list2dict:
-        return primop::list2dict(args);
+        return primop::list2dict(scm, args);
 #endif
     default:
         throw std::invalid_argument("invalid primary opcode");
@@ -2683,6 +3079,11 @@ void add_environment_defaults(Scheme& scm)
           { scm.symbol("set!"),             Intern::_setb },
           { scm.symbol("lambda"),           Intern::_lambda },
           { scm.symbol("define-macro"),     Intern::_macro },
+          { scm.symbol("define-syntax"),    Intern::_define_syntax },
+          { scm.symbol("define-record-type"), Intern::_define_record_type },
+          { scm.symbol("syntax-rules"),     Intern::_syntax_rules },
+          { scm.symbol("receive"),          Intern::_receive },
+          { scm.symbol("let-values"),       Intern::_let_values },
           { scm.symbol("quote"),            Intern::_quote },
           { scm.symbol("quasiquote"),       Intern::_quasiquote },
           { scm.symbol("unquote"),          Intern::_unquote },
@@ -2877,11 +3278,17 @@ void add_environment_defaults(Scheme& scm)
           { scm.symbol("for-each"),                       Intern::op_foreach },
           { scm.symbol("call/cc"),                        Intern::op_callcc },
           { scm.symbol("call-with-current-continuation"), Intern::op_callcc },
+          { scm.symbol("values"),                         Intern::op_values },
           { scm.symbol("call-with-values"),               Intern::op_callwval },
 
           /* Section 6.11: Exceptions */
           { scm.symbol("error"),                  Intern::op_error },
           { scm.symbol("with-exception-handler"), Intern::op_with_exception },
+          { scm.symbol("raise"),                  Intern::op_raise },
+          { scm.symbol("raise-continuable"),      Intern::op_raisecont },
+          { scm.symbol("error-object?"),          Intern::op_iserrobj },
+          { scm.symbol("error-object-message"),   Intern::op_errobjmsg },
+          { scm.symbol("error-object-irritants"), Intern::op_errobjirr },
           { scm.symbol("exit"),                   Intern::op_exit },
 
           /* Section 6.12: Environments and evaluation */
@@ -2890,6 +3297,12 @@ void add_environment_defaults(Scheme& scm)
           { scm.symbol("repl"),                    Intern::op_repl },
           { scm.symbol("gc"),                      Intern::op_gc },
           { scm.symbol("gc-dump"),                 Intern::op_gcdump },
+          { scm.symbol("optimize"),                Intern::op_optimize },
+          { scm.symbol("compile-numeric"),         Intern::op_compile },
+          { scm.symbol("depth-limit"),             Intern::op_depth_limit },
+          { scm.symbol("eval-budget"),             Intern::op_eval_budget },
+          { scm.symbol("memory-budget"),           Intern::op_memory_budget },
+          { scm.symbol("frame-pool"),              Intern::op_frame_pool },
           { scm.symbol("macro-expand"),            Intern::op_macroexp },
 
           /* Section 6.13: Input and output */
@@ -2923,6 +3336,10 @@ void add_environment_defaults(Scheme& scm)
 
           /* Section 6.14: System interface */
           { scm.symbol("load"), Intern::op_load },
+          { scm.symbol("expand-file"), Intern::op_expand_file },
+          { scm.symbol("translate-file"), Intern::op_translate_file },
+          { scm.symbol("file-exists?"), Intern::op_fileok },
+          { scm.symbol("delete-file"), Intern::op_delfile },
 
 #ifdef PSCM_REGEXPS
           /* Extension: regular expressions */
@@ -2950,6 +3367,15 @@ void add_environment_defaults(Scheme& scm)
           { scm.symbol("dict->list"),   Intern::op_dict2list},
           { scm.symbol("list->dict"),   Intern::op_list2dict},
 #endif
+          { scm.symbol("make-coroutine"), Intern::op_make_coroutine },
+          { scm.symbol("close-coroutine"), Intern::op_close_coroutine },
+          { scm.symbol("yield"),          Intern::op_yield },
+          { scm.symbol("spawn"),          Intern::op_spawn },
+          { scm.symbol("sleep"),          Intern::op_sleep },
+          { scm.symbol("make-channel"),   Intern::op_make_channel },
+          { scm.symbol("channel-send"),   Intern::op_channel_send },
+          { scm.symbol("channel-receive"), Intern::op_channel_receive },
+          { scm.symbol("run-threads"),    Intern::op_run_threads },
           { scm.symbol("use-count"),    Intern::op_usecount },
           { scm.symbol("hash"),         Intern::op_hash },
        });
@@ -11,7 +11,7 @@
 
 #include <vector>
 
-#include "types.hpp"
+#include "cell.hpp"
 
 class Scheme;
 
@@ -26,6 +26,118 @@ namespace pscm {
  */
 Cell call(Scheme& scm, const SymenvPtr& senv, Intern primop, const std::vector<Cell>& args);
 
+/**
+ * Call a binary arithmetic operation or comparison inline, if both arguments are floating
+ * point numbers or both are integers and the result doesn't overflow. This type guard
+ * replaces the generic number dispatch of the primary function for the common case.
+ *
+ * @param[out] result Function result, same as of the primary function.
+ * @return False, if the primary function must be called instead.
+ */
+inline bool call_arithmetic(Intern primop, const Cell& lhs, const Cell& rhs, Cell& result)
+{
+    // Opcode test first, to keep the number type guard off all other primary functions:
+    if ((primop < Intern::op_numeq || primop > Intern::op_max)
+        && (primop < Intern::op_add || primop > Intern::op_div))
+        return false;
+
+    if (!is_number(lhs) || !is_number(rhs))
+        return false;
+
+    const Number &x = get<Number>(lhs), &y = get<Number>(rhs);
+
+    if (is_float(x) && is_float(y)) {
+        Float a = get<Float>(x), b = get<Float>(y);
+
+        switch (primop) {
+        case Intern::op_add:
+            result = Number{ (0. + a) + b }; // sum starts with exact zero
+            return true;
+        case Intern::op_sub:
+            result = Number{ a - b };
+            return true;
+        case Intern::op_mul:
+            result = Number{ (1. * a) * b }; // product starts with exact one
+            return true;
+        case Intern::op_div:
+            if (b == 0.)
+                return false;
+            result = Number{ a / b };
+            return true;
+        case Intern::op_numeq:
+            result = a == b;
+            return true;
+        case Intern::op_numlt:
+            result = a < b;
+            return true;
+        case Intern::op_numgt:
+            result = a > b;
+            return true;
+        case Intern::op_numle:
+            result = a <= b;
+            return true;
+        case Intern::op_numge:
+            result = a >= b;
+            return true;
+        case Intern::op_min:
+            result = Number{ b < a ? b : a };
+            return true;
+        case Intern::op_max:
+            result = Number{ b > a ? b : a };
+            return true;
+        default:
+            return false;
+        }
+    }
+    if (is_int(x) && is_int(y)) {
+        Int i = get<Int>(x), j = get<Int>(y);
+
+        switch (primop) {
+        case Intern::op_add:
+            if (overflow_add(i, j))
+                return false;
+            result = Number{ i + j };
+            return true;
+        case Intern::op_sub:
+            if (overflow_sub(i, j))
+                return false;
+            result = Number{ i - j };
+            return true;
+        case Intern::op_mul:
+            if (overflow_mul(i, j))
+                return false;
+            result = Number{ i * j };
+            return true;
+        case Intern::op_numeq:
+            result = i == j;
+            return true;
+        case Intern::op_numlt:
+            result = i < j;
+            return true;
+        case Intern::op_numgt:
+            result = i > j;
+            return true;
+        case Intern::op_numle:
+            result = i <= j;
+            return true;
+        case Intern::op_numge:
+            result = i >= j;
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+//! Predicate returns true, if a primary function might add new bindings to, or
+//! lookup arbitrary symbols in its calling environment.
+bool is_environment_primop(Intern primop);
+
+//! Predicate returns true for a primary function without side effects, which returns
+//! the same result for the same number, boolean or character arguments.
+bool is_pure_primop(Intern primop);
+
 //! Install scheme opcodes, standard symbols and common mathematical and physical constants.
 void add_environment_defaults(Scheme& scm);
 
@@ -6,9 +6,13 @@
  * @author    Paul Pudewills
  * @copyright MIT License
  *************************************************************************************/
+#include <algorithm>
 #include <set>
+#include <vector>
 
+#include "primop.hpp"
 #include "scheme.hpp"
+#include "syntax.hpp"
 
 namespace pscm {
 
@@ -37,43 +41,542 @@ static bool is_unique_symbol_list(Cell args)
     return is_nil(args) || (is_symbol(args) && symset.insert(get<Symbol>(args)).second);
 }
 
+namespace {
+
+//! Predicate returns true, if both sorted symbol ranges have no common symbol.
+template <typename Range>
+bool is_disjoint(const Range& lhs, const Range& rhs)
+{
+    for (auto i = lhs.begin(), j = rhs.begin(); i != lhs.end() && j != rhs.end();)
+        if (*i < *j)
+            ++i;
+        else if (*j < *i)
+            ++j;
+        else
+            return false;
+
+    return true;
+}
+
+template <typename Vector>
+void sort_unique(Vector& vec)
+{
+    std::sort(vec.begin(), vec.end());
+    vec.erase(std::unique(vec.begin(), vec.end()), vec.end());
+}
+} // namespace
+
 /**
- * Closure to capture an environment pointer, a formal
- * argument list and a code list of one or more scheme expressions.
+ * Lambda expression, shared by all closures of this expression, together with
+ * the result of a free variable analysis of its body.
+ *
+ * The analysis collects all symbols of the body, which are not quoted, and all
+ * symbols bound by the formal parameter list or by a define expression.
+ * A lambda expression is closed, if the body doesn't reference a macro or any
+ * function, which might access the calling environment (eval, load, ...).
+ * Call frames of a closed lambda expression bind only symbols of its scope
+ * and a closure of a closed lambda expression doesn't need to capture parent
+ * environments with a closed scope, which bind none of its free symbols.
+ * A closed lambda expression is a leaf, if its body doesn't create any closure.
+ * A call frame of a leaf can't escape the procedure call.
+ *
+ * The body of a closed lambda expression is passed once to the optional optimiser.
+ *
+ * The rest parameter list of a leaf of the top environment, which is only passed to
+ * primary functions, which neither return nor keep its cons-cells, can't escape the
+ * procedure call either. It reuses the cons-cells of the previous call instead of new
+ * cons-cells of the global store, unless another call frame still binds them or the
+ * garbage collector might have released them.
+ *
+ * @remark Unexpanded macros are expanded in place at their first evaluation. A
+ *         lambda expression with macro references is reanalysed after further
+ *         macro expansions, until all references are expanded.
  */
-struct Procedure::Closure {
+struct Procedure::Lambda {
+    enum class State {
+        unknown, //!< Not analysed yet.
+        pending, //!< Body references unexpanded macros.
+        closed, //!< All free symbols are known.
+        open //!< Body might access symbols of the calling environment.
+    };
 
-    Closure(const SymenvPtr& senv, const Cell& args, const Cell& code, bool is_macro)
-        : senv{ senv }
-        , args{ args }
+    Lambda(const Cell& args, const Cell& code, bool is_macro, std::pmr::memory_resource* mres)
+        : args{ args }
         , code{ code }
         , is_macro{ is_macro }
+        , free{ mres }
+        , scope{ mres }
+        , state{ is_macro ? State::open : State::unknown }
+        , rest{ mres }
     {
         if (!is_unique_symbol_list(args) || !is_pair(code))
             throw std::invalid_argument("invalid procedure definition");
+
+        Cell iter = args;
+
+        while (is_pair(iter))
+            iter = cdr(iter);
+
+        has_rest = is_symbol(iter);
     }
-    bool operator!=(const Closure& impl) const noexcept
+
+    //! Analyse this lambda expression, if not yet done or if macros might have been expanded or
+    //! global symbols rebound since.
+    void update(Scheme& scm, const SymenvPtr& env)
     {
-        return senv != impl.senv
-            || args != impl.args
-            || code != impl.code
-            || is_macro != impl.is_macro;
+        if (state == State::unknown || (state == State::pending && epoch != scm.expand_count)
+            || (!is_macro && bind_epoch != scm.bind_count)) {
+            analyse(scm, env);
+            epoch = scm.expand_count;
+            bind_epoch = scm.bind_count;
+        }
+        if (state == State::closed && !is_optimized && scm.optimizer.enabled()) {
+            is_optimized = true;
+            scm.optimizer.optimize(scm, env, scope, code);
+        }
     }
-    SymenvPtr senv; //!< Symbol environment pointer.
+
+    //! Return the innermost environment of argument environment, which has to be captured
+    //! by a closure, skipping all environments which can't bind any free symbol.
+    const SymenvPtr& capture(const SymenvPtr& env) const
+    {
+        const SymenvPtr* senv = &env;
+
+        if (state == State::closed)
+            while (*senv && (*senv)->scope() && is_disjoint(*(*senv)->scope(), free))
+                senv = &(*senv)->parent();
+
+        return *senv;
+    }
+
     Cell args; //!< Formal parameter symbol list or single symbol.
     Cell code; //!< Lambda body expression list.
     bool is_macro;
+    std::shared_ptr<const SyntaxRules> rules; //!< Compiled transformer of a syntax-rules macro.
+
+    std::pmr::vector<Symbol> free; //!< Sorted symbols of the body without formal parameters.
+    std::pmr::vector<Symbol> scope; //!< Sorted symbols bound by a call frame.
+    State state;
+    size_t epoch = 0; //!< Macro expansion count at the last analysis.
+    size_t bind_epoch = 0; //!< Global rebinding count at the last analysis.
+    bool is_leaf = false; //!< True, if call frames can't escape the procedure call.
+    bool has_rest = false; //!< True, if the formal parameters end with a rest parameter.
+    bool is_optimized = false; //!< True, if the body was passed to the optimiser.
+
+    std::shared_ptr<Kernel> kernel; //!< Compiled procedure or null-pointer.
+    size_t kernel_epoch = 0; //!< Compilation epoch of the kernel.
+
+    std::pmr::vector<Cons*> rest; //!< Reused rest parameter cons-cells of the last call.
+    size_t rest_cycle = 0; //!< Garbage collector cycle, up to which the reused cons-cells are kept.
+
+    /**
+     * Return the list of the evaluated remaining argument expressions of a call, which
+     * is bound to the rest parameter of the argument call frame.
+     */
+    Cell rest_list(Scheme& scm, const SymenvPtr& env, const SymenvPtr& frame, Cell args)
+    {
+        if (!is_pair(args))
+            return nil;
+
+        if (rest_epoch != scm.rest_epoch) {
+            rest_epoch = scm.rest_epoch;
+            is_rest_local = is_local(scm);
+        }
+        // Reentrant calls during the argument evaluation fall back to the cons-cell store:
+        if (!is_rest_local || !rest_frame.expired())
+            return scm.eval_list(env, args, true);
+
+        size_t size = 0;
+
+        for (Cell iter = args; is_pair(iter); iter = cdr(iter))
+            ++size;
+
+        if (rest_cycle != scm.gc.cycles()) { // the garbage collector might have released the cons-cells
+            rest.clear();
+            rest_cycle = scm.gc.cycles();
+        }
+        while (rest.size() < size)
+            rest.push_back(scm.cons(nil, nil));
+
+        rest_frame = frame;
+
+        for (size_t i = 0; i < size; ++i, args = cdr(args)) {
+            set_car(rest[i], scm.eval_value(env, car(args)));
+            set_cdr(rest[i], i + 1 < size ? Cell{ rest[i + 1] } : Cell{ nil });
+        }
+        return rest[0];
+    }
+
+private:
+    std::vector<Symbol> defines; //!< Defined symbols, collected during analysis.
+    std::vector<Symbol> locals; //!< Formal parameters of nested lambda expressions, collected during analysis.
+    std::vector<Symbol> unbound; //!< Unbound operator symbols, collected during analysis.
+    size_t macro_args = 0; //!< Nesting depth of macro arguments during analysis.
+
+    bool is_rest_local = false; //!< True, if the rest parameter list can't escape a call.
+    size_t rest_epoch = 0; //!< Rest parameter epoch of the interpreter at the last escape analysis.
+    std::weak_ptr<Symenv> rest_frame; //!< Call frame of the last call, which binds the reused cons-cells.
+
+    void analyse(Scheme& scm, const SymenvPtr& env)
+    {
+        free.clear();
+        scope.clear();
+        state = State::closed;
+        is_leaf = true;
+        macro_args = 0;
+
+        for (Cell iter = args;; iter = cdr(iter))
+            if (is_pair(iter))
+                scope.push_back(get<Symbol>(car(iter)));
+            else {
+                if (is_symbol(iter))
+                    scope.push_back(get<Symbol>(iter));
+                break;
+            }
+        sort_unique(scope); // formal parameters only
+
+        visit(scm, env, code);
+        sort_unique(free);
+
+        // Remove formal parameters from the free symbols and add defined symbols to the scope:
+        free.erase(std::remove_if(free.begin(), free.end(), [this](const Symbol& sym) {
+            return std::binary_search(scope.begin(), scope.end(), sym);
+        }),
+            free.end());
+
+        scope.insert(scope.end(), defines.begin(), defines.end());
+        defines.clear();
+        sort_unique(scope);
+
+        // An unbound operator symbol might be defined as macro later, which requires a new analysis:
+        sort_unique(locals);
+
+        for (const Symbol& sym : unbound)
+            if (!std::binary_search(scope.begin(), scope.end(), sym) && !std::binary_search(locals.begin(), locals.end(), sym)) {
+                scm.pending_deps.insert(sym);
+
+                if (state == State::closed)
+                    state = State::pending;
+            }
+        locals.clear();
+        unbound.clear();
+    }
+
+    void visit(Scheme& scm, const SymenvPtr& env, Cell expr)
+    {
+        if (is_symbol(expr))
+            return symbol(env, get<Symbol>(expr));
+
+        if (!is_pair(expr))
+            return;
+
+        Cell op = car(expr);
+
+        if (is_symbol(op)) {
+            const Cell* val = env ? env->find(get<Symbol>(op)) : nullptr;
+
+            if (!val && !macro_args)
+                unbound.push_back(get<Symbol>(op));
+
+            op = val ? *val : none;
+        }
+        if (is_intern(op))
+            switch (get<Intern>(op)) {
+            case Intern::_quote:
+                return;
+
+            case Intern::_syntax_rules: // syntax rules are data, but the macro captures the frame
+                is_leaf = false;
+                return;
+
+            case Intern::_lambda: // (lambda formals body ...)
+                is_leaf = false;
+
+                if (is_pair(cdr(expr))) {
+                    local(cadr(expr));
+                    expr = cddr(expr);
+                }
+                break;
+
+            case Intern::_quasiquote: // compile the template and analyse the constructor expression
+                if (!macro_args)
+                    scm.syntax_quasiquote(expr);
+                break;
+
+            case Intern::_receive: // (receive formals expr body ...)
+                if (is_pair(cdr(expr))) {
+                    bind(cadr(expr));
+                    expr = cddr(expr);
+                }
+                break;
+
+            case Intern::_let_values: // (let-values ((formals expr) ...) body ...)
+                if (is_pair(cdr(expr))) {
+                    for (Cell iter = cadr(expr); is_pair(iter); iter = cdr(iter))
+                        if (is_pair(car(iter))) {
+                            bind(caar(iter));
+                            visit(scm, env, cdar(iter));
+                        }
+                    expr = cddr(expr);
+                }
+                break;
+
+            case Intern::_define:
+            case Intern::_macro:
+            case Intern::_define_syntax:
+                if (is_pair(cdr(expr))) {
+                    if (is_pair(cadr(expr)) || get<Intern>(op) != Intern::_define)
+                        is_leaf = false; // closure definition
+
+                    Cell sym = is_pair(cadr(expr)) ? car(cadr(expr)) : cadr(expr);
+
+                    if (is_pair(cadr(expr)))
+                        local(cdr(cadr(expr)));
+
+                    if (is_symbol(sym))
+                        defines.push_back(get<Symbol>(sym));
+                }
+                break;
+
+            default:
+                break;
+            }
+
+        // Arguments of a macro are data, which must be passed unchanged:
+        macro_args += pscm::is_macro(op);
+
+        for (/* */; is_pair(expr); expr = cdr(expr))
+            visit(scm, env, car(expr));
+
+        visit(scm, env, expr);
+        macro_args -= pscm::is_macro(op);
+    }
+
+    //! Add the symbols of a formal parameter list of a nested lambda expression to the local symbols.
+    void local(Cell formals)
+    {
+        for (/* */; is_pair(formals); formals = cdr(formals))
+            if (is_symbol(car(formals)))
+                locals.push_back(get<Symbol>(car(formals)));
+
+        if (is_symbol(formals))
+            locals.push_back(get<Symbol>(formals));
+    }
+
+    //! Add the symbols of a formal parameter list, which are bound by a local environment, to the defined symbols.
+    void bind(Cell formals)
+    {
+        for (/* */; is_pair(formals); formals = cdr(formals))
+            if (is_symbol(car(formals)))
+                defines.push_back(get<Symbol>(car(formals)));
+
+        if (is_symbol(formals))
+            defines.push_back(get<Symbol>(formals));
+    }
+
+    void symbol(const SymenvPtr& env, const Symbol& sym)
+    {
+        free.push_back(sym);
+
+        const Cell* val = env ? env->find(sym) : nullptr;
+
+        if (!val || state == State::open)
+            return;
+
+        if (pscm::is_macro(*val))
+            state = State::pending;
+
+        else if (is_func(*val) || (is_intern(*val) && is_environment_primop(get<Intern>(*val))))
+            state = State::open;
+    }
+
+    //! Return true, if the rest parameter list can only be passed to primary functions, which neither
+    //! return nor keep its cons-cells, and register their global symbols as rest dependencies.
+    bool is_local(Scheme& scm)
+    {
+        Cell sym = args;
+
+        while (is_pair(sym))
+            sym = cdr(sym);
+
+        std::vector<Symbol> deps;
+
+        for (Cell iter = code; is_pair(iter); iter = cdr(iter))
+            if (escapes(scm, sym, scm.optimizer.original(iter), deps))
+                return false;
+
+        scm.rest_deps.insert(deps.begin(), deps.end());
+        return true;
+    }
+
+    //! Return the global syntax keyword or primary function of an operator symbol, which isn't
+    //! bound by a call frame, or none otherwise.
+    Cell global(Scheme& scm, const Cell& op, std::vector<Symbol>& deps) const
+    {
+        if (!is_symbol(op) || std::binary_search(scope.begin(), scope.end(), get<Symbol>(op)))
+            return none;
+
+        const Cell* val = scm.topenv->find(get<Symbol>(op));
+
+        if (!val || !is_intern(*val))
+            return none;
+
+        deps.push_back(get<Symbol>(op));
+        return *val;
+    }
+
+    //! Predicate returns true for a primary function, which neither returns nor keeps the cons-cells of a list argument.
+    static bool is_local_primop(Intern opcode)
+    {
+        switch (opcode) {
+        case Intern::op_car:
+        case Intern::op_caar:
+        case Intern::op_cadr:
+        case Intern::op_caddr:
+        case Intern::op_isnil:
+        case Intern::op_ispair:
+        case Intern::op_islist:
+        case Intern::op_length:
+        case Intern::op_listref:
+        case Intern::op_listcopy:
+        case Intern::op_reverse:
+        case Intern::op_assq:
+        case Intern::op_assv:
+        case Intern::op_assoc:
+        case Intern::op_liststr:
+        case Intern::op_listvec:
+        case Intern::op_map:
+        case Intern::op_foreach:
+        case Intern::op_write:
+        case Intern::op_display:
+        case Intern::op_write_shared:
+        case Intern::op_write_simple:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    //! Return true, if the rest parameter list might escape by an expression or its value.
+    bool escapes(Scheme& scm, const Cell& sym, const Cell& expr, std::vector<Symbol>& deps) const
+    {
+        if (!is_pair(expr))
+            return expr == sym;
+
+        Cell op = scm.optimizer.original(expr);
+
+        if (escapes(scm, sym, op, deps))
+            return true;
+
+        Cell val = global(scm, op, deps);
+
+        if (is_intern(val) && get<Intern>(val) == Intern::_quote)
+            return false;
+
+        Cell iter = cdr(expr);
+
+        for (/* */; is_pair(iter); iter = cdr(iter)) {
+            Cell arg = scm.optimizer.original(iter);
+
+            if (arg != sym) {
+                if (escapes(scm, sym, arg, deps))
+                    return true;
+            }
+            // (apply primop arg ... rest) passes the list items as arguments to a primary function:
+            else if (is_intern(val) && get<Intern>(val) == Intern::_apply) {
+                Cell primop = global(scm, scm.optimizer.original(cdr(expr)), deps);
+
+                if (!is_nil(cdr(iter)) || !is_intern(primop) || get<Intern>(primop) < Intern::op_eq)
+                    return true;
+            } else if (!is_intern(val) || !is_local_primop(get<Intern>(val)))
+                return true;
+        }
+        return iter == sym;
+    }
+};
+
+/**
+ * Closure to capture an environment pointer and a shared lambda expression.
+ */
+struct Procedure::Closure {
+
+    Closure(const SymenvPtr& senv, const std::shared_ptr<Lambda>& lambda)
+        : senv{ senv }
+        , lambda{ lambda }
+    {
+    }
+    bool operator!=(const Closure& impl) const noexcept
+    {
+        return senv != impl.senv || lambda != impl.lambda;
+    }
+    SymenvPtr senv; //!< Symbol environment pointer.
+    std::shared_ptr<Lambda> lambda; //!< Lambda expression.
 };
 
-Procedure::Procedure(const SymenvPtr& senv, const Cell& args, const Cell& code, bool is_macro)
-    : impl{ std::make_shared<Closure>(senv, args, code, is_macro) }
+Procedure::Procedure(Scheme& scm, const SymenvPtr& senv, const Cell& args, const Cell& code, bool is_macro)
+    : Procedure{ scm, senv, scm.make_shared<Lambda>(args, code, is_macro, scm.memory_resource()) }
+{
+}
+
+Procedure::Procedure(Scheme& scm, const SymenvPtr& senv, const Procedure& lambda)
+    : Procedure{ scm, senv, lambda.impl->lambda }
+{
+}
+
+Procedure Procedure::syntax_rules(Scheme& scm, const Cell& literals, const Cell& rules)
 {
+    auto lambda = scm.make_shared<Lambda>(literals, rules, true, scm.memory_resource());
+    lambda->rules = scm.make_shared<SyntaxRules>(scm, literals, rules);
+    return { scm, nullptr, lambda };
+}
+
+Procedure::Procedure(Scheme& scm, const SymenvPtr& senv, const std::shared_ptr<Lambda>& lambda)
+{
+    if (senv)
+        lambda->update(scm, senv);
+
+    impl = scm.make_shared<Closure>(lambda->capture(senv), lambda);
 }
 
 Cell Procedure::senv() const noexcept { return impl->senv; }
-Cell Procedure::args() const noexcept { return impl->args; }
-Cell Procedure::code() const noexcept { return impl->code; }
-bool Procedure::is_macro() const noexcept { return impl->is_macro; }
+Cell Procedure::args() const noexcept { return impl->lambda->args; }
+Cell Procedure::code() const noexcept { return impl->lambda->code; }
+bool Procedure::is_macro() const noexcept { return impl->lambda->is_macro; }
+bool Procedure::is_template() const noexcept { return !impl->senv; }
+
+const std::pmr::vector<Cons*>& Procedure::keep_rest(size_t cycle) const
+{
+    Lambda& lambda = *impl->lambda;
+
+    if (lambda.rest_cycle == cycle) // valid cons-cells are kept for the next cycle
+        lambda.rest_cycle = cycle + 1;
+    else if (lambda.rest_cycle != cycle + 1) // released by a previous cycle
+        lambda.rest.clear();
+
+    return lambda.rest;
+}
+
+bool Procedure::is_leaf() const noexcept
+{
+    return impl->lambda->state == Lambda::State::closed && impl->lambda->is_leaf;
+}
+
+const Kernel* Procedure::kernel(Scheme& scm) const
+{
+    Lambda& lambda = *impl->lambda;
+
+    // A kernel only depends on global bindings and is shared by all closures of the top environment:
+    if (impl->senv != scm.topenv)
+        return nullptr;
+
+    if (lambda.kernel_epoch != scm.compiler.epoch()) {
+        lambda.kernel_epoch = scm.compiler.epoch();
+        lambda.kernel = nullptr; // not callable by a mutually recursive procedure during its compilation
+        lambda.update(scm, impl->senv);
+        lambda.kernel = is_leaf() && !lambda.is_macro ? scm.compiler.compile(scm, *this) : nullptr;
+    }
+    return lambda.kernel.get();
+}
 
 bool Procedure::operator!=(const Procedure& proc) const noexcept
 {
@@ -92,31 +595,48 @@ bool Procedure::operator==(const Procedure& proc) const noexcept
  *
  * @remark A dotted formal parameter list or a single symbol argument
  *         requires additional cell-storage to build the evaluated
- *         argument list.
+ *         argument list, which a leaf reuses, if the list can't escape.
  */
-std::pair<SymenvPtr, Cell> Procedure::apply(Scheme& scm, const SymenvPtr& env, Cell args, bool is_list) const
+SymenvPtr Procedure::frame(Scheme& scm) const
 {
-    // Create a new child environment and set the closure environment as father:
-    SymenvPtr newenv = scm.newenv(impl->senv);
+    Lambda& lambda = *impl->lambda;
+    lambda.update(scm, impl->senv);
+
+    // Create a new child environment and set the closure environment as father. The new
+    // environment of a closed lambda expression binds only the symbols of its scope. A leaf
+    // frame with a rest parameter isn't pooled, since rest_frame refers to it after the call:
+    return lambda.state == Lambda::State::closed
+        ? scm.newenv(impl->senv, Symenv::scope_type{ impl->lambda, &lambda.scope }, lambda.is_leaf && !lambda.has_rest)
+        : scm.newenv(impl->senv);
+}
 
-    Cell iter = impl->args; // closure formal parameter symbol list
+std::pair<SymenvPtr, Cell> Procedure::apply(Scheme& scm, const SymenvPtr& env, Cell args, bool is_list) const
+{
+    SymenvPtr newenv = frame(scm);
+    Lambda& lambda = *impl->lambda;
+    Cell iter = lambda.args; // closure formal parameter symbol list
 
     if (is_list) { // Evaluate each list item of a (lambda args body) expression argument list:
         for (/* */; is_pair(iter) && is_pair(args); iter = cdr(iter), args = cdr(args))
-            newenv->add(get<Symbol>(car(iter)), scm.eval(env, car(args)));
+            newenv->add(get<Symbol>(car(iter)), scm.eval_value(env, car(args)));
 
         // Handle the last symbol of a dotted formal parameter list or a single symbol lambda
         // argument. This symbol is assigned to the evaluated list of remaining expressions
-        // which requires additional cons-cell storage.
+        // which requires additional cons-cell storage, unless the list can't escape the call.
         if (iter != args)
-            newenv->add(get<Symbol>(iter), scm.eval_list(env, args, is_list));
+            newenv->add(get<Symbol>(iter), is_leaf() && impl->senv == scm.topenv
+                    ? lambda.rest_list(scm, env, newenv, args)
+                    : scm.eval_list(env, args, is_list));
     } else {
         // Evaluate each argument of a (apply proc x y ... args) expression and add to newenv:
         for (/* */; is_pair(iter) && is_pair(cdr(args)); iter = cdr(iter), args = cdr(args))
-            newenv->add(get<Symbol>(car(iter)), scm.eval(env, car(args)));
+            newenv->add(get<Symbol>(car(iter)), scm.eval_value(env, car(args)));
 
         if (is_nil(cdr(args))) {
-            args = scm.eval(env, car(args)); // last list item must evaluate to nil or a list
+            args = scm.eval_value(env, car(args)); // last list item must evaluate to nil or a list
+
+            if (scm.is_unwinding()) // the body returns immediately during a non-local exit
+                return { newenv, lambda.code };
 
             // Add each list item of this list to newenv:
             for (/* */; is_pair(iter) && is_pair(args); iter = cdr(iter), args = cdr(args))
@@ -127,32 +647,68 @@ std::pair<SymenvPtr, Cell> Procedure::apply(Scheme& scm, const SymenvPtr& env, C
         } else
             newenv->add(get<Symbol>(iter), scm.eval_list(env, args, is_list));
     }
-    return { newenv, impl->code };
+    return { newenv, lambda.code };
+}
+
+std::pair<SymenvPtr, Cell> Procedure::bind(Scheme& scm, const Cell* argv, size_t argc) const
+{
+    SymenvPtr newenv = frame(scm);
+    const Cell* end = argv + argc;
+    Cell iter = impl->lambda->args;
+
+    for (/* */; is_pair(iter) && argv != end; iter = cdr(iter), ++argv)
+        newenv->add(get<Symbol>(car(iter)), *argv);
+
+    if (is_symbol(iter)) { // bind the remaining values as list
+        Cell list = nil;
+
+        while (end != argv)
+            list = scm.cons(*--end, list);
+
+        newenv->add(get<Symbol>(iter), list);
+    } else
+        (is_nil(iter) && argv == end) || (void(throw std::invalid_argument("invalid number of arguments")), 0);
+
+    return { newenv, impl->lambda->code };
 }
 
 /**
  * @brief Expand a macro
  */
-Cell Procedure::expand(Scheme& scm, Cell& expr) const
+Cell Procedure::expand(Scheme& scm, const SymenvPtr& env, Cell& expr) const
 {
     is_macro() || (void(throw std::invalid_argument("expand - not a macro")), 0);
 
-    Cell args = cdr(expr), iter = impl->args; // macro formal parameter symbol list
+    Cell args = cdr(expr), iter = impl->lambda->args; // macro formal parameter symbol list
 
-    // Create a new child environment and set the closure environment as father:
-    SymenvPtr newenv = scm.newenv(impl->senv);
+    if (impl->lambda->rules) // syntax-rules macro:
+        args = impl->lambda->rules->expand(scm, impl->senv, env, expr);
+    else {
+        // Create a new child environment and set the closure environment as father:
+        SymenvPtr newenv = scm.newenv(impl->senv);
 
-    // Add unevaluated macro parameters to new environment:
-    for (/* */; is_pair(iter) && is_pair(args); iter = cdr(iter), args = cdr(args))
-        newenv->add(get<Symbol>(car(iter)), car(args));
+        // Add unevaluated macro parameters to new environment:
+        for (/* */; is_pair(iter) && is_pair(args); iter = cdr(iter), args = cdr(args))
+            newenv->add(get<Symbol>(car(iter)), car(args));
 
-    if (iter != args)
-        newenv->add(get<Symbol>(iter), args);
+        if (iter != args)
+            newenv->add(get<Symbol>(iter), args);
+
+        args = scm.eval(newenv, scm.syntax_begin(newenv, impl->lambda->code));
 
-    // Expand and replace argument expression with evaluated macro:
+        if (scm.is_unwinding()) // keep the macro call for the next evaluation
+            return none;
+    }
+    // Replace argument expression with the expanded macro:
     set_car(expr, Intern::_begin);
-    set_car(cdr(expr), args = scm.eval(newenv, scm.syntax_begin(newenv, impl->code)));
-    set_cdr(cdr(expr), nil);
+
+    if (is_pair(cdr(expr))) {
+        set_car(cdr(expr), args);
+        set_cdr(cdr(expr), nil);
+    } else // macro call without arguments
+        set_cdr(expr, scm.cons(args, nil));
+
+    ++scm.expand_count;
     return args;
 }
 
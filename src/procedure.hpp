@@ -10,12 +10,15 @@
 #define PROCEDURE_HPP
 
 #include <functional>
+#include <memory_resource>
+#include <vector>
 
 #include "types.hpp"
 
 namespace pscm {
 
 class Scheme;
+struct Kernel;
 
 /**
  * Procedure type to represent a scheme closure.
@@ -32,12 +35,36 @@ class Scheme;
 class Procedure {
 public:
     /**
-     * Construct a new closure.
+     * Construct a new closure, allocated from the memory resource of the scheme interpreter.
      * @param senv  Symbol environment pointer to capture.
      * @param args  Formal lambda expression argument list or symbol.
      * @param code  Non empty list of one or more scheme expression forming the lambda body.
      */
-    Procedure(const SymenvPtr& senv, const Cell& args, const Cell& code, bool is_macro = false);
+    Procedure(Scheme& scm, const SymenvPtr& senv, const Cell& args, const Cell& code, bool is_macro = false);
+
+    /**
+     * Construct a new closure from an already validated closure template, which only
+     * captures the symbol environment. Parent environments, which can't bind any free
+     * symbol of the lambda expression, are not captured.
+     * @param senv   Symbol environment pointer to capture.
+     * @param lambda Closure template with a null-pointer environment.
+     */
+    Procedure(Scheme& scm, const SymenvPtr& senv, const Procedure& lambda);
+
+    /**
+     * Construct a new syntax-rules macro template without environment, where the
+     * syntax rules are compiled into a shared SyntaxRules transformer.
+     * @param literals Literal symbol list or custom ellipsis symbol.
+     * @param rules    Non empty syntax rule list.
+     */
+    static Procedure syntax_rules(Scheme& scm, const Cell& literals, const Cell& rules);
+
+    /// Predicate returns true if this procedure is a closure template without environment.
+    bool is_template() const noexcept;
+
+    /// Predicate returns true if this procedure is a closure of a closed lambda expression,
+    /// which doesn't create any closure itself.
+    bool is_leaf() const noexcept;
 
     /// Predicate returns true if closure should be applied as macro.
     bool is_macro() const noexcept;
@@ -46,6 +73,20 @@ public:
     Cell args() const noexcept;
     Cell code() const noexcept;
 
+    /**
+     * Return the reused rest parameter cons-cells of the last call of a leaf procedure, which
+     * the garbage collector has to mark in its current cycle to keep them for the next call.
+     * Cons-cells released by a previous cycle, when the procedure wasn't reachable, are dropped.
+     */
+    const std::pmr::vector<Cons*>& keep_rest(size_t cycle) const;
+
+    /**
+     * Return the compiled kernel of this procedure or null-pointer, if the
+     * procedure can't be compiled. The procedure is compiled at most once per
+     * compilation epoch of the interpreter compiler.
+     */
+    const Kernel* kernel(Scheme& scm) const;
+
     bool operator!=(const Procedure& proc) const noexcept;
     bool operator==(const Procedure& proc) const noexcept;
 
@@ -66,12 +107,24 @@ public:
     std::pair<SymenvPtr, Cell> apply(Scheme& scm, const SymenvPtr& env, Cell args, bool is_list = true) const;
 
     /**
-     * Replace expression with the expanded closure macro.
+     * Closure application to evaluated arguments.
+     * @param argv  Argument values.
+     * @param argc  Number of argument values.
+     *
+     * @return New child environment of the closure parent environment and the closure body
+     *         expression list.
+     */
+    std::pair<SymenvPtr, Cell> bind(Scheme& scm, const Cell* argv, size_t argc) const;
+
+    /**
+     * Replace expression with the expanded closure or syntax-rules macro.
+     * @param env  Environment of the macro call.
      * @param expr (closure-macro arg0 ... arg_n)
      * @return The expanded macro body.
      */
-    Cell expand(Scheme& scm, Cell& expr) const;
+    Cell expand(Scheme& scm, const SymenvPtr& env, Cell& expr) const;
 
+    struct Lambda;
     struct Closure;
 
     struct hash : private std::hash<Closure*> {
@@ -85,6 +138,11 @@ public:
     };
 
 private:
+    Procedure(Scheme& scm, const SymenvPtr& senv, const std::shared_ptr<Lambda>& lambda);
+
+    //! Return a new call frame environment of this closure.
+    SymenvPtr frame(Scheme& scm) const;
+
     std::shared_ptr<Closure> impl;
 };
 
@@ -99,12 +157,23 @@ class Function : public std::function<Cell(Scheme&, const SymenvPtr&, const std:
     using function_type = std::function<Cell(Scheme&, const SymenvPtr&, const std::vector<Cell>&)>;
 
 public:
+    /**
+     * Create a new shared function object, allocated from the argument memory resource.
+     * A function object, whose captures exceed the small object buffer of std::function,
+     * still allocates them from the default heap.
+     */
     template <typename FunctionT>
-    static FunctionPtr create(const Symbol& sym, FunctionT&& fun)
+    static FunctionPtr create(const Symbol& sym, FunctionT&& fun,
+        std::pmr::memory_resource* mres = std::pmr::get_default_resource())
     {
-        return std::shared_ptr<Function>{
-            new Function{ sym, function_type{ std::forward<FunctionT>(fun) } }
+        struct Access : Function {
+            Access(const Symbol& sym, function_type&& fun)
+                : Function{ sym, std::move(fun) }
+            {
+            }
         };
+        return std::allocate_shared<Access>(std::pmr::polymorphic_allocator<Access>{ mres },
+            sym, function_type{ std::forward<FunctionT>(fun) });
     }
 
     const String& name() const { return sym.value(); };
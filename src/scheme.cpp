@@ -6,6 +6,7 @@
  * @author    Paul Pudewills
  * @copyright MIT License
  *************************************************************************************/
+#include <algorithm>
 #include <functional>
 #include <iomanip>
 
@@ -26,24 +27,34 @@ static_assert(std::is_same_v<Symbol, Symtab::Symbol>);
 static_assert(std::is_same_v<Symenv, SymenvPtr::element_type>);
 static_assert(std::is_same_v<Function, FunctionPtr::element_type>);
 
-Scheme::Scheme(const SymenvPtr& env)
-    : topenv{ Symenv::create(env) }
+Scheme::Scheme(const SymenvPtr& env, std::pmr::memory_resource* mres)
+    : budget{ mres }
+    , topenv{ Symenv::create(env, this->mres) }
 {
     pscm::add_environment_defaults(*this);
 }
 
 Cell Scheme::apply(const SymenvPtr& env, Intern opcode, const std::vector<Cell>& args)
 {
+    if (unwind_target) // the arguments of a non-local exit are incomplete
+        return none;
+
     return pscm::call(*this, env, opcode, args);
 }
 
 Cell Scheme::apply(const SymenvPtr& env, const FunctionPtr& proc, const std::vector<Cell>& args)
 {
+    if (unwind_target)
+        return none;
+
     return (*proc)(*this, env, args);
 }
 
 Cell Scheme::apply(const SymenvPtr& env, const Cell& cell, const std::vector<Cell>& args)
 {
+    if (unwind_target)
+        return none;
+
     if (is_intern(cell))
         return apply(env, get<Intern>(cell), args);
     else
@@ -55,14 +66,262 @@ std::pair<SymenvPtr, Cell> Scheme::apply(const SymenvPtr& env, const Cell& proc,
     return get<Procedure>(proc).apply(*this, env, args, is_list);
 }
 
-Cell Scheme::expand(const Cell& macro, Cell& args)
+Cell Scheme::expand(const SymenvPtr& env, const Cell& macro, Cell& args)
+{
+    return get<Procedure>(macro).expand(*this, env, args);
+}
+
+bool Scheme::unwind(size_t id, const std::vector<Cell>& args)
+{
+    auto iter = std::find_if(escapes.rbegin(), escapes.rend(),
+        [id](const std::pair<size_t, Cell>& escape) { return escape.first == id; });
+
+    if (iter == escapes.rend())
+        return false;
+
+    unwind_target = id;
+    unwind_args = args;
+    return true;
+}
+
+bool Scheme::raise(const std::vector<Cell>& args)
+{
+    auto iter = std::find_if(escapes.rbegin(), escapes.rend(),
+        [](const std::pair<size_t, Cell>& escape) { return !is_none(escape.second); });
+
+    return iter != escapes.rend() && unwind(iter->first, args);
+}
+
+bool Scheme::raise_continuable(const SymenvPtr& env, const Cell& obj, Cell& result)
 {
-    return get<Procedure>(macro).expand(*this, args);
+    size_t idx = escapes.size();
+
+    while (idx && is_none(escapes[idx - 1].second))
+        --idx;
+
+    if (!idx)
+        return false;
+
+    // Deactivate the handler during its own call and restore it, even if left by an exception:
+    struct Restore {
+        std::vector<std::pair<size_t, Cell>>& escapes;
+        size_t idx;
+        Cell handler;
+        ~Restore() { escapes[idx].second = handler; }
+    } restore{ escapes, idx - 1, std::exchange(escapes[idx - 1].second, none) };
+
+    result = pscm::apply(*this, env, restore.handler, obj);
+    return true;
+}
+
+/**
+ * Walker to expand all macro calls of an expression and of all nested lambda bodies
+ * in place. Symbols bound by a formal parameter list or an internal definition
+ * shadow global macros in their scope. A macro call, which can't be expanded yet,
+ * is left unchanged for the lazy expansion at its first evaluation.
+ */
+struct Scheme::Expander {
+    Scheme& scm;
+    const SymenvPtr& env;
+    std::vector<Symbol> locals = {}; //!< Locally bound symbols of the enclosing lambda expressions.
+    size_t depth = 0; //!< Nesting depth of lambda expressions.
+
+    bool is_local(const Symbol& sym) const
+    {
+        return std::find(locals.begin(), locals.end(), sym) != locals.end();
+    }
+
+    //! Add the symbols of a formal parameter list or a single symbol to the local symbols.
+    void bind(Cell args)
+    {
+        for (/* */; is_pair(args); args = cdr(args))
+            if (is_symbol(car(args)))
+                locals.push_back(get<Symbol>(car(args)));
+
+        if (is_symbol(args))
+            locals.push_back(get<Symbol>(args));
+    }
+
+    //! Expand a lambda body in the scope of the formal parameters.
+    void lambda(const Cell& args, const Cell& body)
+    {
+        size_t size = locals.size();
+        ++depth;
+        bind(args);
+        sequence(body);
+        locals.erase(locals.begin() + size, locals.end());
+        --depth;
+    }
+
+    //! Expand all list items and replace each expanded macro call with an atom expansion by the atom.
+    void sequence(Cell list)
+    {
+        for (/* */; is_pair(list); list = cdr(list)) {
+            Cell item = expr(car(list));
+
+            if (!is_pair(item))
+                set_car(list, item);
+        }
+    }
+
+    //! Expand an expression in place and return the expression or an atom expansion.
+    Cell expr(Cell expr)
+    {
+        while (is_pair(expr)) {
+            Cell op = car(expr);
+
+            if (is_symbol(op)) {
+                const Cell* val = is_local(get<Symbol>(op)) ? nullptr : env->find(get<Symbol>(op));
+                op = val ? *val : none;
+            }
+            if (is_macro(op)) {
+                try {
+                    op = get<Procedure>(op).expand(scm, env, expr);
+                } catch (const std::exception&) {
+                    return expr;
+                }
+                if (!is_pair(op))
+                    return op;
+
+                // Replace (begin expansion) by the expansion itself:
+                set_car(expr, car(op));
+                set_cdr(expr, cdr(op));
+                continue;
+            }
+            if (is_intern(op))
+                switch (get<Intern>(op)) {
+                case Intern::_quote:
+                case Intern::_macro:
+                case Intern::_define_syntax:
+                case Intern::_define_record_type:
+                case Intern::_syntax_rules:
+                    return expr;
+
+                case Intern::_quasiquote:
+                    scm.syntax_quasiquote(expr);
+                    continue;
+
+                case Intern::_lambda:
+                    if (is_pair(cdr(expr)))
+                        lambda(cadr(expr), cddr(expr));
+                    return expr;
+
+                case Intern::_receive: // (receive formals expr body ...)
+                    if (is_pair(cdr(expr)) && is_pair(cddr(expr))) {
+                        if (Cell item = this->expr(caddr(expr)); !is_pair(item))
+                            set_car(cddr(expr), item);
+
+                        lambda(cadr(expr), cdr(cddr(expr)));
+                    }
+                    return expr;
+
+                case Intern::_let_values: // (let-values ((formals expr) ...) body ...)
+                    if (is_pair(cdr(expr))) {
+                        size_t size = locals.size();
+
+                        for (Cell iter = cadr(expr); is_pair(iter); iter = cdr(iter))
+                            if (is_pair(car(iter)) && is_pair(cdar(iter)))
+                                sequence(cdar(iter));
+
+                        ++depth;
+                        for (Cell iter = cadr(expr); is_pair(iter); iter = cdr(iter))
+                            if (is_pair(car(iter)))
+                                bind(caar(iter));
+
+                        sequence(cddr(expr));
+                        locals.erase(locals.begin() + size, locals.end());
+                        --depth;
+                    }
+                    return expr;
+
+                case Intern::_define:
+                    if (is_pair(cdr(expr))) {
+                        if (depth) // internal definition
+                            bind(is_pair(cadr(expr)) ? car(cadr(expr)) : cadr(expr));
+
+                        if (is_pair(cadr(expr))) // (define (symbol . args) body ...)
+                            lambda(cdr(cadr(expr)), cddr(expr));
+                        else
+                            sequence(cddr(expr));
+                    }
+                    return expr;
+
+                default:
+                    break;
+                }
+            sequence(expr);
+            break;
+        }
+        return expr;
+    }
+};
+
+Cell Scheme::expand_all(const SymenvPtr& env, const Cell& expr)
+{
+    return Expander{ *this, env }.expr(expr);
+}
+
+namespace {
+    //! Count the nesting depth of read-eval-print loops and loaded files.
+    struct DepthGuard {
+        DepthGuard(size_t& depth) noexcept
+            : depth{ ++depth }
+        {
+        }
+        ~DepthGuard() { --depth; }
+        size_t& depth;
+    };
+}
+
+void Scheme::recover_memory(const SymenvPtr& env)
+{
+    if (toplevel_depth != 1)
+        return;
+
+    // Suspended coroutines and green threads keep their cons-cell references on explicit stacks:
+    if (budget.exhausted()) {
+        gc.collect(*this, env);
+        budget.clear();
+    }
+    frames.release();
+}
+
+void Scheme::eval_budget(size_t fuel, std::chrono::milliseconds timeout)
+{
+    max_fuel = fuel;
+    max_time = timeout;
+    restart_budget();
+}
+
+void Scheme::restart_budget()
+{
+    using clock = std::chrono::steady_clock;
+
+    fuel = max_fuel;
+    deadline = max_time.count() > 0 ? clock::now() + max_time : clock::time_point::max();
+    ticks = slice = fuel ? std::min(fuel, dflt_fuel_slice) : dflt_fuel_slice;
+}
+
+void Scheme::preempt()
+{
+    using clock = std::chrono::steady_clock;
+
+    bool is_empty = fuel && !(fuel -= slice);
+    bool is_late = deadline != clock::time_point::max() && clock::now() >= deadline;
+
+    if (is_empty || is_late) { // continue unlimited, to let an exception handler evaluate
+        fuel = 0;
+        deadline = clock::time_point::max();
+        ticks = slice = dflt_fuel_slice;
+        throw budget_exhausted{ is_empty ? "evaluation fuel exhausted" : "evaluation deadline exceeded" };
+    }
+    ticks = slice = fuel ? std::min(fuel, dflt_fuel_slice) : dflt_fuel_slice;
 }
 
 void Scheme::repl(const SymenvPtr& env)
 {
     const SymenvPtr& senv = env ? env : getenv();
+    DepthGuard guard{ toplevel_depth };
     Parser parser{ *this };
 
     auto &out = outPort().stream(), &in = inPort().stream();
@@ -72,9 +331,17 @@ void Scheme::repl(const SymenvPtr& env)
             for (;;) {
                 out << "> ";
                 expr = none;
+                recover_memory(senv);
                 expr = parser.read(in);
+
+                if (toplevel_depth == 1)
+                    restart_budget();
+
                 expr = eval(senv, expr);
 
+                if (unwind_target)
+                    return;
+
                 if (is_none(expr))
                     continue;
 
@@ -91,27 +358,34 @@ void Scheme::repl(const SymenvPtr& env)
         }
 }
 
-void Scheme::load(const String& filename, const SymenvPtr& env)
+template <typename Reader>
+void Scheme::load(const SymenvPtr& env, bool expand, Reader&& read)
 {
-    using file_port = FilePort<Char>;
     const SymenvPtr& senv = env ? env : getenv();
+    DepthGuard guard{ toplevel_depth };
 
-    Parser parser{ *this };
     Cell expr = none;
 
     auto& out = outPort().stream();
 
     try {
-        file_port in{ filename, file_port::in };
+        for (;;) {
+            recover_memory(senv);
 
-        if (!in.is_open())
-            throw std::ios_base::failure("couldn't open input file: '"s
-                + string_convert<char>(filename) + "'"s);
+            if (!read(expr))
+                break;
+
+            if (expand)
+                expr = expand_all(senv, expr);
+
+            if (toplevel_depth == 1)
+                restart_budget();
 
-        while (!in.eof()) {
-            expr = parser.read(in);
             expr = eval(senv, expr);
             expr = none;
+
+            if (unwind_target) // non-local exit out of the loaded file
+                break;
         }
     } catch (const std::exception& e) {
         if (is_none(expr))
@@ -119,6 +393,43 @@ void Scheme::load(const String& filename, const SymenvPtr& env)
         else
             out << e.what() << ": " << expr << '\n';
     }
+    expr = none;
+    recover_memory(senv);
+}
+
+void Scheme::load(const String& filename, const SymenvPtr& env, bool expand)
+{
+    using file_port = FilePort<Char>;
+    file_port in{ filename, file_port::in };
+    Parser parser{ *this };
+
+    load(env, expand, [&](Cell& expr) {
+        if (!in.is_open())
+            throw std::ios_base::failure("couldn't open input file: '"s
+                + string_convert<char>(filename) + "'"s);
+
+        if (in.eof())
+            return false;
+
+        expr = parser.read(in);
+        return true;
+    });
+}
+
+void Scheme::load(const Script& script, const SymenvPtr& env, bool expand)
+{
+    size_t index = 0;
+
+    load(env, expand, [&](Cell& expr) {
+        if (index < script.size) {
+            expr = script.expr(*this, index++);
+            return true;
+        }
+        if (script.error)
+            throw parse_error(script.error);
+
+        return false;
+    });
 }
 
 Cell Scheme::syntax_begin(const SymenvPtr& env, Cell args)
@@ -134,7 +445,7 @@ Cell Scheme::syntax_begin(const SymenvPtr& env, Cell args)
 
 Cell Scheme::syntax_if(const SymenvPtr& env, const Cell& args)
 {
-    if (is_true(eval(env, car(args))))
+    if (is_true(eval_value(env, car(args))))
         return cadr(args);
 
     else if (const Cell& last = cddr(args); !is_nil(last))
@@ -144,51 +455,162 @@ Cell Scheme::syntax_if(const SymenvPtr& env, const Cell& args)
         return none;
 }
 
-Cell Scheme::syntax_cond(const SymenvPtr& env, Cell args)
+Cell Scheme::syntax_cond(const SymenvPtr& env, Cell args, Cell& receiver, bool& is_value)
 {
-    Cell test = false, expr = nil;
+    receiver = none;
+    is_value = true;
 
-    // For each clause evaluate <test> condition
+    // Find the first clause with a true <test> condition:
     for (/* */; is_pair(args); args = cdr(args)) {
         is_pair(car(args)) || (void(throw std::invalid_argument("invalid cond syntax")), 0);
 
-        if (is_false(test)) {
-            test = eval(env, caar(args));
+        Cell test = eval_value(env, caar(args));
 
-            if (is_true(test))
-                expr = cdar(args);
-        }
-    }
-    if (is_true(test)) {
-        if (is_nil(expr))
-            return test;
+        if (unwind_target)
+            return none;
+
+        if (is_false(test))
+            continue;
+
+        Cell expr = cdar(args);
 
-        const Cell& first = car(expr);
+        if (is_nil(expr)) // clause: (<test>)
+            return test;
 
-        // clause: (<test> => <expr> ...)  -> (apply <expr> <test> nil) ...
-        if (is_arrow(first) || (is_symbol(first) && is_arrow(eval(env, first)))) {
-            !is_else(test) || (void(throw std::invalid_argument("invalid cond syntax")), 0);
+        // Lookup a symbol only, since evaluating the first expression might have side effects:
+        const Cell* first = &car(expr);
 
-            Cons cons[4], argv[2];
-            Cell apply_expr = pscm::list(cons, Intern::_apply, none,
-                pscm::list(argv, Intern::_quote, test), nil);
+        if (is_symbol(*first))
+            first = env->find(get<Symbol>(*first));
 
-            // For each expression, first replace none in apply_expr and then call eval:
-            for (expr = cdr(expr); is_pair(cdr(expr)); expr = cdr(expr)) {
-                set_car(cdr(apply_expr), car(expr));
-                eval(env, apply_expr);
-            }
-            // Return last expression to evaluated at the call site to maintain unbound tail-recursion:
-            return list(Intern::_apply, car(expr), list(Intern::_quote, test), nil);
-        } else
+        if (!first || !is_arrow(*first)) {
+            is_value = false;
             return syntax_begin(env, expr);
+        }
+        // clause: (<test> => <expression> ...)
+        !is_else(test) || (void(throw std::invalid_argument("invalid cond syntax")), 0);
+
+        for (expr = cdr(expr); is_pair(expr); expr = cdr(expr)) {
+            Cell proc = eval(env, car(expr));
+
+            if (unwind_target)
+                return none;
+
+            if (is_pair(cdr(expr)))
+                pscm::apply(*this, env, proc, test);
+
+            else if (is_proc(proc) && !is_macro(proc)) { // call the last receiver at the call site to maintain unbound tail-recursion
+                receiver = proc;
+                is_value = false;
+                return test;
+            } else
+                return apply(env, proc, std::vector<Cell>{ test });
+        }
+        throw std::invalid_argument("invalid cond syntax");
     }
     return none;
 }
 
+namespace {
+    /**
+     * Compiler of a quasiquote template into a constructor expression of
+     * quoted constants and cons, list, append and list->vector calls.
+     */
+    struct Quasiquote {
+        Scheme& scm;
+        const Symbol quasiquote = scm.symbol("quasiquote");
+        const Symbol unquote = scm.symbol("unquote");
+        const Symbol splice = scm.symbol("unquote-splicing");
+
+        //! Predicate returns true for a list (sym expr).
+        bool is_form(const Cell& tmpl, const Symbol& sym) const
+        {
+            return is_pair(tmpl) && is_symbol(car(tmpl)) && get<Symbol>(car(tmpl)) == sym
+                && is_pair(cdr(tmpl)) && is_nil(cddr(tmpl));
+        }
+
+        //! Predicate returns true for a quoted or self-evaluating expression.
+        static bool is_constant(const Cell& expr)
+        {
+            return is_pair(expr) ? is_intern(car(expr)) && get<Intern>(car(expr)) == Intern::_quote
+                                 : !is_symbol(expr);
+        }
+
+        //! Return the value of a constant expression.
+        static Cell value(const Cell& expr) { return is_pair(expr) ? cadr(expr) : expr; }
+
+        Cell quote(const Cell& val)
+        {
+            return is_symbol(val) || is_pair(val) ? scm.list(Intern::_quote, val) : val;
+        }
+
+        //! Combine the constructors of car and cdr of a template pair.
+        Cell combine(const Cell& lhs, const Cell& rhs, const Cell& tmpl)
+        {
+            if (is_constant(lhs) && is_constant(rhs)) {
+                if (value(lhs) == car(tmpl) && value(rhs) == cdr(tmpl))
+                    return quote(tmpl); // share the constant template
+
+                return quote(scm.cons(value(lhs), value(rhs)));
+            }
+            if (is_constant(rhs) && is_nil(value(rhs)))
+                return scm.list(Intern::op_list, lhs);
+
+            if (is_pair(rhs) && is_intern(car(rhs)) && get<Intern>(car(rhs)) == Intern::op_list)
+                return scm.cons(Intern::op_list, scm.cons(lhs, cdr(rhs)));
+
+            return scm.list(Intern::op_cons, lhs, rhs);
+        }
+
+        Cell compile(const Cell& tmpl, size_t depth)
+        {
+            if (is_vector(tmpl)) {
+                const Vector& vec = *get<VectorPtr>(tmpl);
+                Cell list = nil;
+
+                for (auto iter = vec.rbegin(); iter != vec.rend(); ++iter)
+                    list = scm.cons(*iter, list);
+
+                Cell expr = compile(list, depth);
+                return is_constant(expr) ? tmpl : scm.list(Intern::op_listvec, expr);
+            }
+            if (!is_pair(tmpl))
+                return quote(tmpl);
+
+            if (is_form(tmpl, unquote) || is_form(tmpl, splice))
+                return depth ? combine(quote(car(tmpl)), compile(cdr(tmpl), depth - 1), tmpl)
+                             : cadr(tmpl);
+
+            if (is_form(tmpl, quasiquote))
+                return combine(quote(car(tmpl)), compile(cdr(tmpl), depth + 1), tmpl);
+
+            if (!depth && is_form(car(tmpl), splice)) {
+                Cell rhs = compile(cdr(tmpl), depth);
+
+                return is_constant(rhs) && is_nil(value(rhs))
+                    ? scm.list(Intern::op_append, cadr(car(tmpl)))
+                    : scm.list(Intern::op_append, cadr(car(tmpl)), rhs);
+            }
+            return combine(compile(car(tmpl), depth), compile(cdr(tmpl), depth), tmpl);
+        }
+    };
+}
+
+Cell Scheme::syntax_quasiquote(const Cell& expr)
+{
+    (is_pair(cdr(expr)) && is_nil(cddr(expr)))
+        || (void(throw std::invalid_argument("invalid quasiquote syntax")), 0);
+
+    Cell ctor = Quasiquote{ *this }.compile(cadr(expr), 0);
+
+    set_car(expr, Intern::_begin);
+    set_car(cdr(expr), ctor);
+    return ctor;
+}
+
 Cell Scheme::syntax_when(const SymenvPtr& env, Cell args)
 {
-    if (is_true(eval(env, car(args))) && is_pair(args = cdr(args))) {
+    if (is_true(eval_value(env, car(args))) && is_pair(args = cdr(args))) {
         for (/* */; is_pair(cdr(args)); args = cdr(args))
             eval(env, car(args));
 
@@ -199,7 +621,7 @@ Cell Scheme::syntax_when(const SymenvPtr& env, Cell args)
 
 Cell Scheme::syntax_unless(const SymenvPtr& env, Cell args)
 {
-    if (is_false(eval(env, car(args))) && is_pair(args = cdr(args))) {
+    if (is_false(eval_value(env, car(args))) && is_pair(args = cdr(args))) {
         for (/* */; is_pair(cdr(args)); args = cdr(args))
             eval(env, car(args));
 
@@ -214,7 +636,7 @@ Cell Scheme::syntax_and(const SymenvPtr& env, Cell args)
 
     if (is_pair(args)) {
         for (/* */; is_pair(cdr(args)); args = cdr(args))
-            if (is_false(res = eval(env, car(args))))
+            if (is_false(res = eval_value(env, car(args))))
                 return res;
 
         is_nil(cdr(args)) || (void(throw std::invalid_argument("not a proper list")), 0);
@@ -223,16 +645,182 @@ Cell Scheme::syntax_and(const SymenvPtr& env, Cell args)
     return res;
 }
 
-Cell Scheme::syntax_or(const SymenvPtr& env, Cell args)
+Cell Scheme::values(const std::vector<Cell>& args)
+{
+    if (args.size() == 1)
+        return args.front();
+
+    if (&args != &mvalues)
+        mvalues.assign(args.begin(), args.end()); // reuses the buffer capacity
+
+    return Intern::_values;
+}
+
+Cell Scheme::raise_values(const Cell& expr)
+{
+    // raise as (error "multiple values in a single value context" <expr>)
+    Cell obj = cons(str("multiple values in a single value context"), cons(expr, nil));
+
+    if (!raise({ obj }))
+        throw std::invalid_argument("multiple values in a single value context");
+
+    return none;
+}
+
+void Scheme::bind_values(const SymenvPtr& env, Cell formals, const Cell& val)
+{
+    const Cell *iter = &val, *end = iter + 1;
+
+    if (is_values(val))
+        iter = mvalues.data(), end = iter + mvalues.size();
+
+    for (/* */; is_pair(formals); formals = cdr(formals), ++iter) {
+        iter != end || (void(throw std::invalid_argument("too few values")), 0);
+        env->add(get<Symbol>(car(formals)), *iter);
+    }
+    if (is_symbol(formals)) { // bind the remaining values as list
+        Cell list = nil;
+
+        while (end != iter)
+            list = cons(*--end, list);
+
+        env->add(get<Symbol>(formals), list);
+    } else
+        iter == end || (void(throw std::invalid_argument("too many values")), 0);
+}
+
+Cell Scheme::syntax_receive(SymenvPtr& env, const Cell& args)
+{
+    Cell val = eval(env, cadr(args));
+
+    if (unwind_target)
+        return none;
+
+    env = newenv(env);
+    bind_values(env, car(args), val);
+    return syntax_begin(env, cddr(args));
+}
+
+Cell Scheme::syntax_let_values(SymenvPtr& env, const Cell& args)
+{
+    SymenvPtr frame = newenv(env);
+
+    // Evaluate each expression in the outer environment and bind its values:
+    for (Cell iter = car(args); is_pair(iter); iter = cdr(iter)) {
+        Cell val = eval(env, cadr(car(iter)));
+
+        if (unwind_target)
+            return none;
+
+        bind_values(frame, caar(iter), val);
+    }
+    env = std::move(frame);
+    return syntax_begin(env, cdr(args));
+}
+
+//! Return the record argument of a record function, if it is a record of the argument type.
+static Record& record(const Symbol& sym, const RecordPtr& type, const Cell& arg)
+{
+    if (!is_record(arg) || get<RecordPtr>(arg)->type != type)
+        throw std::invalid_argument(string_convert<char>(sym.value()) + " - not a record of type "
+            + string_convert<char>(get<Symbol>(type->slots[0]).value()));
+
+    return *get<RecordPtr>(arg);
+}
+
+//! Throw an invalid argument exception, unless a record function is called with n arguments.
+static void record_arity(const Symbol& sym, const std::vector<Cell>& args, size_t n)
+{
+    args.size() == n
+        || (void(throw std::invalid_argument(string_convert<char>(sym.value()) + " - invalid number of arguments")), 0);
+}
+
+void Scheme::syntax_define_record_type(const SymenvPtr& env, const Cell& args)
+{
+    Cell ctor = cadr(args), pred = caddr(args), fields = cdr(cddr(args));
+    auto type = make_shared<Record>(nullptr, 1, mres);
+    type->slots[0] = get<Symbol>(car(args));
+
+    for (Cell iter = fields; is_pair(iter); iter = cdr(iter))
+        type->slots.push_back(get<Symbol>(caar(iter)));
+
+    auto define = [this, &env](const Cell& sym, const Cell& val) {
+        env->add(get<Symbol>(sym), val);
+
+        if (env == topenv) // restore optimised and compiled code, which depends on a previous definition
+            deoptimize(get<Symbol>(sym));
+    };
+    auto slot = [&type](const Cell& field) -> size_t {
+        auto pos = std::find(type->slots.begin() + 1, type->slots.end(), field);
+
+        pos != type->slots.end()
+            || (void(throw std::invalid_argument("define-record-type - unknown field")), 0);
+
+        return static_cast<size_t>(pos - type->slots.begin() - 1);
+    };
+    define(car(args), type);
+
+    if (is_pair(ctor)) { // (<constructor> <field> ...)
+        const Symbol& sym = get<Symbol>(car(ctor));
+        std::vector<size_t> index;
+
+        for (Cell iter = cdr(ctor); is_pair(iter); iter = cdr(iter))
+            index.push_back(slot(car(iter)));
+
+        define(sym, Function::create(sym, [sym, type, index](Scheme& scm, const SymenvPtr&, const std::vector<Cell>& args) -> Cell {
+            record_arity(sym, args, index.size());
+
+            auto rec = scm.make_shared<Record>(type, type->slots.size() - 1, scm.mres);
+
+            for (size_t i = 0; i < index.size(); ++i)
+                rec->slots[index[i]] = args[i];
+
+            return rec;
+        }, mres));
+    }
+    if (is_symbol(pred))
+        define(pred, Function::create(get<Symbol>(pred), [sym = get<Symbol>(pred), type](Scheme&, const SymenvPtr&, const std::vector<Cell>& args) -> Cell {
+            record_arity(sym, args, 1);
+            return is_record(args[0]) && get<RecordPtr>(args[0])->type == type;
+        }, mres));
+
+    for (Cell iter = fields; is_pair(iter); iter = cdr(iter)) {
+        Cell spec = cdar(iter); // (<accessor> [<modifier>])
+        size_t i = slot(caar(iter));
+
+        if (is_pair(spec)) {
+            const Symbol& sym = get<Symbol>(car(spec));
+
+            define(sym, Function::create(sym, [sym, type, i](Scheme&, const SymenvPtr&, const std::vector<Cell>& args) -> Cell {
+                record_arity(sym, args, 1);
+                return record(sym, type, args[0]).slots[i];
+            }, mres));
+            spec = cdr(spec);
+        }
+        if (is_pair(spec)) {
+            const Symbol& sym = get<Symbol>(car(spec));
+
+            define(sym, Function::create(sym, [sym, type, i](Scheme&, const SymenvPtr&, const std::vector<Cell>& args) -> Cell {
+                record_arity(sym, args, 2);
+                record(sym, type, args[0]).slots[i] = args[1];
+                return none;
+            }, mres));
+        }
+    }
+}
+
+Cell Scheme::syntax_or(const SymenvPtr& env, Cell args, bool& is_value)
 {
     Cell res = false;
+    is_value = true;
 
     if (is_pair(args)) {
         for (/* */; is_pair(cdr(args)); args = cdr(args))
-            if (is_true(res = eval(env, car(args))))
-                return list(Intern::_quote, res);
+            if (is_true(res = eval_value(env, car(args))))
+                return res;
 
         is_nil(cdr(args)) || (void(throw std::invalid_argument("not a proper list")), 0);
+        is_value = false;
         return car(args);
     }
     return res;
@@ -244,26 +832,26 @@ Cell Scheme::eval_list(const SymenvPtr& env, Cell list, bool is_list)
         return nil;
 
     if (is_list) {
-        Cell head = cons(eval(env, car(list)), cdr(list));
+        Cell head = cons(eval_value(env, car(list)), cdr(list));
         list = cdr(list);
 
         for (Cell tail = head; is_pair(list); tail = cdr(tail), list = cdr(list))
-            set_cdr(tail, cons(eval(env, car(list)), cdr(list)));
+            set_cdr(tail, cons(eval_value(env, car(list)), cdr(list)));
 
         return head;
     }
     Cell tail, head;
 
     if (is_pair(cdr(list)))
-        head = cons(eval(env, car(list)), cdr(list));
+        head = cons(eval_value(env, car(list)), cdr(list));
     else
-        head = eval(env, car(list));
+        head = eval_value(env, car(list));
 
     for (tail = head, list = cdr(list); is_pair(list); tail = cdr(tail), list = cdr(list))
         if (is_pair(cdr(list)))
-            set_cdr(tail, cons(eval(env, car(list)), cdr(list)));
+            set_cdr(tail, cons(eval_value(env, car(list)), cdr(list)));
         else
-            set_cdr(tail, eval(env, car(list)));
+            set_cdr(tail, eval_value(env, car(list)));
 
     is_nil(tail) || is_pair(tail)
         || (void(throw std::invalid_argument("invalid apply argument list")), 0);
@@ -276,7 +864,7 @@ std::vector<Cell> Scheme::eval_args(const SymenvPtr& env, Cell args, bool is_lis
 
     if (is_list) { // expression: (proc x y ... z)
         for (/* */; is_pair(args); args = cdr(args))
-            stack.push_back(eval(env, car(args)));
+            stack.push_back(eval_value(env, car(args)));
 
         return stack;
     }
@@ -285,7 +873,7 @@ std::vector<Cell> Scheme::eval_args(const SymenvPtr& env, Cell args, bool is_lis
 
     // evaluate (x y ...)
     for (/* */; is_pair(args); args = cdr(args))
-        stack.push_back(last = eval(env, car(args)));
+        stack.push_back(last = eval_value(env, car(args)));
 
     if (is_nil(last)) { // last list (args ...) is nil
         if (!stack.empty())
@@ -300,23 +888,81 @@ std::vector<Cell> Scheme::eval_args(const SymenvPtr& env, Cell args, bool is_lis
     return stack;
 }
 
+void Scheme::deoptimize(const Symbol& sym)
+{
+    optimizer.deoptimize(sym);
+    compiler.invalidate(sym);
+
+    if (!rest_deps.empty() && rest_deps.count(sym)) {
+        rest_deps.clear();
+        ++rest_epoch;
+    }
+    // A lambda expression, which calls an unbound symbol, a macro, an external function or an environment
+    // primary function, might change its free symbols or access the calling environment:
+    const Cell* val = topenv->find(sym);
+
+    if ((!pending_deps.empty() && pending_deps.erase(sym))
+        || (val && (is_macro(*val) || is_func(*val) || (is_intern(*val) && is_environment_primop(get<Intern>(*val)))))) {
+        pending_deps.clear();
+        ++bind_count;
+    }
+}
+
+Procedure Scheme::closure(const SymenvPtr& env, const Cell& expr, const Cell& args, bool is_macro)
+{
+    auto pos = templates.find(get<Cons*>(expr));
+
+    // A modified expression, such as an evaluated data list, requires a new template:
+    if (pos == templates.end() || pos->second.args() != args || pos->second.code() != cdr(expr)
+        || pos->second.is_macro() != is_macro)
+        pos = templates.insert_or_assign(get<Cons*>(expr), Procedure{ *this, nullptr, args, cdr(expr), is_macro }).first;
+
+    return { *this, env, pos->second };
+}
+
+Procedure Scheme::syntax_rules(const SymenvPtr& env, const Cell& args)
+{
+    auto pos = templates.find(get<Cons*>(args));
+
+    if (pos == templates.end() || pos->second.args() != car(args) || pos->second.code() != cdr(args))
+        pos = templates.insert_or_assign(get<Cons*>(args), Procedure::syntax_rules(*this, car(args), cdr(args))).first;
+
+    return { *this, env, pos->second };
+}
+
 Cell Scheme::eval(SymenvPtr env, Cell expr)
 {
+    check_depth();
+    DepthGuard guard{ eval_depth };
+
     Cell args, proc;
+    bool is_value; // syntax form returns its value instead of a tail expression
 
     for (;;) {
+        if (unwind_target) // return immediately during a non-local exit
+            return none;
+
         if (is_symbol(expr))
             return env->get(get<Symbol>(expr));
 
         if (!is_pair(expr))
             return expr;
 
+        if (!--ticks) // consume one unit of fuel for each call or syntax form
+            preempt();
+
         if (is_func(proc = eval(env, car(expr))))
             return apply(env, proc, eval_args(env, cdr(expr)));
 
+        if (unwind_target)
+            return none;
+
         if (is_proc(proc)) {
             if (is_macro(proc))
-                expr = expand(proc, expr);
+                expr = expand(env, proc, expr);
+            else if (const Kernel* kernel = compiler.enabled() ? get<Procedure>(proc).kernel(*this) : nullptr;
+                     kernel && compiler.call(*this, *kernel, env, cdr(expr), args))
+                return args;
             else {
                 tie(env, args) = apply(env, proc, cdr(expr));
                 expr = syntax_begin(env, args);
@@ -330,27 +976,59 @@ Cell Scheme::eval(SymenvPtr env, Cell expr)
             return car(args);
 
         case Intern::_setb:
-            env->set(get<Symbol>(car(args)), eval(env, cadr(args)));
+            proc = eval_value(env, cadr(args));
+
+            if (!unwind_target) {
+                env->set(get<Symbol>(car(args)), proc);
+                deoptimize(get<Symbol>(car(args)));
+            }
             return none;
 
         case Intern::_define:
             if (is_pair(car(args)))
-                env->add(get<Symbol>(caar(args)), Procedure{ env, cdar(args), cdr(args) });
+                env->add(get<Symbol>(caar(args)), closure(env, args, cdar(args)));
+            else if (proc = eval_value(env, cadr(args)); !unwind_target)
+                env->add(get<Symbol>(car(args)), proc);
             else
-                env->add(get<Symbol>(car(args)), eval(env, cadr(args)));
+                return none;
+
+            if (env == topenv) // restore optimised and compiled code, which depends on a previous definition
+                deoptimize(get<Symbol>(is_pair(car(args)) ? caar(args) : car(args)));
             return none;
 
         case Intern::_lambda:
-            return Procedure{ env, car(args), cdr(args) };
+            return closure(env, args, car(args));
 
         case Intern::_macro:
-            env->add(get<Symbol>(caar(args)), Procedure{ env, cdar(args), cdr(args), true });
+            env->add(get<Symbol>(caar(args)), closure(env, args, cdar(args), true));
+
+            if (env == topenv)
+                deoptimize(get<Symbol>(caar(args)));
+            return none;
+
+        case Intern::_define_syntax:
+            if (proc = eval(env, cadr(args)); unwind_target)
+                return none;
+
+            is_macro(proc) || (void(throw std::invalid_argument("define-syntax - not a macro")), 0);
+
+            env->add(get<Symbol>(car(args)), proc);
+
+            if (env == topenv)
+                deoptimize(get<Symbol>(car(args)));
             return none;
 
+        case Intern::_define_record_type:
+            syntax_define_record_type(env, args);
+            return none;
+
+        case Intern::_syntax_rules:
+            return syntax_rules(env, args);
+
         case Intern::_apply:
-            if (is_proc(proc = eval(env, car(args)))) {
+            if (is_proc(proc = eval(env, car(args))) && !unwind_target) {
                 if (is_macro(proc))
-                    expr = expand(proc, args);
+                    expr = expand(env, proc, args);
                 else {
                     tie(env, args) = apply(env, proc, cdr(args), false);
                     expr = syntax_begin(env, args);
@@ -368,7 +1046,18 @@ Cell Scheme::eval(SymenvPtr env, Cell expr)
             break;
 
         case Intern::_cond:
-            expr = syntax_cond(env, args);
+            if (expr = syntax_cond(env, args, proc, is_value); is_value)
+                return expr;
+
+            if (is_proc(proc)) { // pass the test value to the receiver of a (<test> => <receiver>) clause
+                Cons cons[1], quote[2];
+                tie(env, args) = apply(env, proc, pscm::list(cons, pscm::list(quote, Intern::_quote, expr)));
+                expr = syntax_begin(env, args);
+            }
+            break;
+
+        case Intern::_quasiquote:
+            expr = syntax_quasiquote(expr);
             break;
 
         case Intern::_when:
@@ -384,10 +1073,27 @@ Cell Scheme::eval(SymenvPtr env, Cell expr)
             break;
 
         case Intern::_or:
-            expr = syntax_or(env, args);
+            if (expr = syntax_or(env, args, is_value); is_value)
+                return expr;
+            break;
+
+        case Intern::_receive:
+            expr = syntax_receive(env, args);
+            break;
+
+        case Intern::_let_values:
+            expr = syntax_let_values(env, args);
             break;
 
         default:
+            if (is_pair(args) && is_pair(cdr(args)) && is_nil(cddr(args))) { // binary primary function
+                Cell lhs = eval_value(env, car(args)), rhs = eval_value(env, cadr(args));
+
+                if (!unwind_target && call_arithmetic(opcode, lhs, rhs, proc))
+                    return proc;
+
+                return apply(env, opcode, { lhs, rhs });
+            }
             return apply(env, opcode, eval_args(env, args));
         }
     }
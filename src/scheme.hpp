@@ -9,37 +9,149 @@
 #ifndef SCHEME_HPP
 #define SCHEME_HPP
 
+#include <algorithm>
+#include <chrono>
 #include <list>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "cell.hpp"
+#include "compiler.hpp"
+#include "coroutine.hpp"
 #include "gc.hpp"
+#include "memory.hpp"
+#include "optimizer.hpp"
 
 namespace pscm {
 
 class GCollector;
 
+/**
+ * Exception thrown by C++ functions, which evaluate scheme expressions but can't pass
+ * an unwinding evaluator state to their caller. It is catched at the escape point of
+ * the non-local exit.
+ */
+struct unwind_exception {
+};
+
+//! Exception of an evaluation, which exceeds the nesting depth limit of the interpreter.
+struct depth_exceeded : public std::runtime_error {
+    explicit depth_exceeded(size_t limit)
+        : std::runtime_error{ "recursion depth limit of " + std::to_string(limit) + " exceeded" }
+        , limit{ limit }
+    {
+    }
+    size_t limit; //!< Nesting depth limit at the time of the failure.
+};
+
+//! Exception of an evaluation, which exhausts its fuel or exceeds its deadline.
+struct budget_exhausted : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * Scheme source file, translated into C++ source by the ::Translator.
+ */
+struct Script {
+    size_t size; //!< Number of top-level expressions.
+    Cell (*expr)(Scheme& scm, size_t index); //!< Construct the top-level expression at index.
+    const char* error; //!< Parse error after the last expression or null-pointer.
+};
+
 /**
  * Scheme interpreter class.
  */
 class Scheme {
 public:
-    //! Optional connect this scheme interpreter to the environment of another interpreter.
-    Scheme(const SymenvPtr& env = nullptr);
+    /**
+     * Construct a new scheme interpreter.
+     *
+     * @param env  Optional connect this scheme interpreter to the environment of another interpreter.
+     * @param mres Upstream memory resource for all allocations of the symbol table, the
+     *             cons-cell store, environments, closures, strings, vectors and dictionaries.
+     *             The memory resource must outlive this interpreter. All allocations are
+     *             accounted by the memory budget of this interpreter.
+     */
+    Scheme(const SymenvPtr& env = nullptr, std::pmr::memory_resource* mres = std::pmr::get_default_resource());
+
+    //! Return the memory resource of this interpreter.
+    std::pmr::memory_resource* memory_resource() const noexcept { return mres; }
+
+    //! Return the memory budget of this interpreter, to query the allocated bytes or
+    //! to set a byte limit for all allocations from the interpreter memory resource.
+    MemoryBudget& memory_budget() noexcept { return budget; }
+    const MemoryBudget& memory_budget() const noexcept { return budget; }
+
+    //! Return the pool of leaf procedure call frames, which is released between two
+    //! top-level expressions, if no pooled frame is live.
+    FramePool& frame_pool() noexcept { return frames; }
+
+    //! Return the nesting depth limit of non-tail evaluations.
+    size_t depth_limit() const noexcept { return max_depth; }
+
+    /**
+     * Set the nesting depth limit of non-tail evaluations. An evaluation exceeding
+     * this limit throws a ::depth_exceeded exception. The native stack is guarded
+     * independent of the limit: a nested evaluation fails, if less than the stack
+     * reserve is left, which is PLATFORM_STACK_RESERVE bytes, but at most a quarter
+     * of the stack left at the outermost evaluation. The default limit of
+     * dflt_max_depth is only a backstop for tasks with a very large stack.
+     */
+    void depth_limit(size_t limit) noexcept { max_depth = limit; }
+
+    /**
+     * Set the execution budget of each following top-level evaluation of the
+     * read-eval-print loop or of a loaded file and restart the budget of the current
+     * evaluation. One unit of fuel is consumed by each evaluation of a procedure call
+     * or syntax form, including each iteration of a tail-recursive loop. The deadline
+     * is checked after each slice of dflt_fuel_slice units. An evaluation, which
+     * exhausts its budget, throws a ::budget_exhausted exception. The budget is
+     * unlimited for the remaining evaluation after the exception.
+     *
+     * @param fuel    Fuel of an evaluation or zero for unlimited fuel.
+     * @param timeout Wall-clock time limit of an evaluation or zero for no deadline.
+     */
+    void eval_budget(size_t fuel, std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+
+    //! Return the remaining fuel of the current evaluation or zero, if unlimited.
+    size_t eval_fuel() const noexcept { return fuel ? fuel - (slice - ticks) : 0; }
 
     //! Return a shared pointer to the top environment of this interpreter.
     SymenvPtr getenv() const { return topenv; }
 
     //! Insert a new symbol and value or reassign an already bound value of an existing symbol
     //! at the top environment of this scheme interpreter.
-    void addenv(const Symbol& sym, const Cell& val) { topenv->add(sym, val); }
+    void addenv(const Symbol& sym, const Cell& val)
+    {
+        topenv->add(sym, val);
+        deoptimize(sym);
+    }
 
     //! Insert or reassign zero or more symbol, value pairs into the
     //! top environment of this interpreter.
-    void addenv(std::initializer_list<std::pair<Symbol, Cell>> args) { topenv->add(args); }
+    void addenv(std::initializer_list<std::pair<Symbol, Cell>> args)
+    {
+        for (auto& [sym, val] : args)
+            addenv(sym, val);
+    }
 
     //! Create a new empty child environment, connected to the argument parent environment
     //! or if null-pointer, connected to the top environment of this interpreter.
-    SymenvPtr newenv(const SymenvPtr& env = nullptr) { return Symenv::create(env ? env : topenv); }
+    SymenvPtr newenv(const SymenvPtr& env = nullptr) { return Symenv::create(env ? env : topenv, mres); }
+
+    /**
+     * Create a new empty child environment with a closed scope of all symbols, the
+     * environment will ever bind, or with an open scope if null-pointer.
+     *
+     * @param is_leaf True for the call frame of a leaf procedure, which can't escape the
+     *                procedure call. It is allocated from a pool of recycled frames.
+     */
+    SymenvPtr newenv(const SymenvPtr& env, const Symenv::scope_type& scope, bool is_leaf = false)
+    {
+        return Symenv::create(env ? env : topenv, scope, is_leaf ? &frames : mres);
+    }
 
     /**
      * Return a pointer to a new cons-cell from the internal cons-cell store.
@@ -68,18 +180,45 @@ public:
         return pscm::list(store, std::forward<T>(t), std::forward<Args>(args)...);
     }
 
+    //! Create a new scheme string from the String constructor arguments.
+    template <typename... Args>
+    StringPtr str(Args&&... args) { return make_shared<String>(std::forward<Args>(args)...); }
+
+    //! Create a new scheme vector from the Vector constructor arguments.
+    template <typename... Args>
+    VectorPtr vec(Args&&... args) { return make_shared<Vector>(std::forward<Args>(args)...); }
+
+    //! Create a new scheme dictionary from the Map constructor arguments.
+    template <typename... Args>
+    MapPtr dict(Args&&... args) { return make_shared<Map>(std::forward<Args>(args)...); }
+
+    /**
+     * Create a new shared object of type T, where the object itself and, for an allocator
+     * aware type T, all of its elements are allocated from the memory resource of
+     * this interpreter.
+     */
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make_shared(Args&&... args)
+    {
+        return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>{ mres }, std::forward<Args>(args)...);
+    }
+
     //! Create a new symbol or return an existing symbol, build from
     //! the argument string.
     template <typename StringT>
     Symbol symbol(const StringT& str)
     {
-        return symtab[string_convert<Char>(str)];
+        if constexpr (std::is_same_v<StringT, String>)
+            return symtab[str]; // copy string only for a new symbol
+        else
+            return symtab[string_convert<Char>(str)];
     }
 
-    //! Create a new symbol, guarenteed not to exist before.
+    //! Create a new symbol, guarenteed not to exist before. The symbol is
+    //! released from the symbol table, when it becomes unreachable.
     Symbol symbol()
     {
-        return symbol(std::string{ "symbol " }.append(std::to_string(symtab.size())));
+        return symbol(std::string{ "symbol " }.append(std::to_string(symbol_count++)));
     }
 
     /**
@@ -100,12 +239,12 @@ public:
     FunctionPtr function(const SymenvPtr& env, const StringT& name, FunctionT&& fun)
     {
         auto sym = symbol(name);
-        auto funptr = Function::create(sym, std::forward<FunctionT>(fun));
+        auto funptr = Function::create(sym, std::forward<FunctionT>(fun), mres);
 
-        if (env)
+        if (env && env != topenv)
             env->add(sym, funptr);
         else
-            topenv->add(sym, funptr);
+            addenv(sym, funptr);
 
         return funptr;
     }
@@ -134,14 +273,32 @@ public:
 
     //! Read scheme expressions from file and evaluate them at the argument
     //! environment or if null-pointer at the top-environment of this interpreter.
-    void load(const String& filename, const SymenvPtr& env = nullptr);
+    //! If expand is true, each expression is fully macro expanded before its evaluation.
+    void load(const String& filename, const SymenvPtr& env = nullptr, bool expand = false);
 
     template <typename StringT>
-    void load(const StringT& filename, const SymenvPtr& env = nullptr)
+    void load(const StringT& filename, const SymenvPtr& env = nullptr, bool expand = false)
     {
-        load(string_convert<Char>(filename), env);
+        load(String{ string_convert<Char>(filename) }, env, expand);
     }
 
+    //! Evaluate the expressions of a translated script like the expressions of its source file.
+    void load(const Script& script, const SymenvPtr& env = nullptr, bool expand = false);
+
+    /**
+     * Expand all macro calls of an expression in place, including the macro calls
+     * of all nested lambda bodies and of all macro expansions, so that the first
+     * evaluation of a procedure doesn't need to expand any macro.
+     *
+     * Macros are resolved in the argument environment at expansion time. A call of
+     * a macro, which is defined later, is still expanded at its first evaluation.
+     *
+     * @param env  Symbol environment to resolve macros.
+     * @param expr Expression to expand.
+     * @return The expanded argument expression or the expansion of a macro call with an atom expansion.
+     */
+    Cell expand_all(const SymenvPtr& env, const Cell& expr);
+
     /**
      * Evaluate a scheme expression at the argument symbol environment.
      *
@@ -152,6 +309,17 @@ public:
      */
     Cell eval(SymenvPtr env, Cell expr);
 
+    /**
+     * Evaluate a scheme expression, whose result is bound or tested as a single value.
+     * The multiple values marker is only valid until the next call of function values
+     * and a multiple values result raises an error object.
+     */
+    Cell eval_value(const SymenvPtr& env, const Cell& expr)
+    {
+        Cell val = eval(env, expr);
+        return is_values(val) ? raise_values(expr) : val;
+    }
+
     /**
      * Return a new list of evaluated expressions in argument list.
      *
@@ -189,7 +357,102 @@ public:
     Cell apply(const SymenvPtr& env, const Cell& cell, const std::vector<Cell>& args);
     std::pair<SymenvPtr, Cell> apply(const SymenvPtr& senv, const Cell& proc, const Cell& args, bool is_list = true);
 
-    Cell expand(const Cell& macro, Cell& args);
+    Cell expand(const SymenvPtr& env, const Cell& macro, Cell& args);
+
+    /**
+     * Escape point of a non-local exit, like an escape continuation, a multiple value
+     * return or a raised exception.
+     *
+     * A non-local exit to an active escape point sets the evaluator into an unwinding
+     * state, where each evaluation returns immediately without any side effect, until
+     * the escape point is reached. Only C++ functions, which can't pass the unwinding
+     * state to their caller, throw an unwind_exception.
+     */
+    class Escape {
+    public:
+        /**
+         * Push a new escape point.
+         * @param handler Exception handler of with-exception-handler, which is installed
+         *                for the extent of this escape point or none.
+         */
+        Escape(Scheme& scm, const Cell& handler = none)
+            : scm{ scm }
+            , ident{ ++scm.escape_count }
+        {
+            scm.escapes.emplace_back(ident, handler);
+        }
+        ~Escape()
+        {
+            scm.escapes.pop_back();
+
+            if (scm.unwind_target == ident)
+                scm.unwind_target = 0;
+        }
+        Escape(const Escape&) = delete;
+        Escape& operator=(const Escape&) = delete;
+
+        //! Return the unique identifier of this escape point.
+        size_t id() const noexcept { return ident; }
+
+        //! Return true and stop the unwinding with the exit values, if this
+        //! escape point is the target of the current non-local exit.
+        bool reached(std::vector<Cell>& args) noexcept
+        {
+            if (scm.unwind_target != ident)
+                return false;
+
+            scm.unwind_target = 0;
+            args.swap(scm.unwind_args);
+            scm.unwind_args.clear();
+            return true;
+        }
+
+    private:
+        Scheme& scm;
+        size_t ident;
+    };
+
+    /**
+     * Start a non-local exit to an active escape point.
+     *
+     * @param id   Identifier of the escape point.
+     * @param args Exit values.
+     * @return False, if the escape point is not active anymore.
+     */
+    bool unwind(size_t id, const std::vector<Cell>& args);
+
+    /**
+     * Return the result of the scheme function @em values. A single value is returned
+     * unchanged, otherwise the values are stored in the value buffer of this interpreter
+     * and the multiple values marker Intern::_values is returned.
+     */
+    Cell values(const std::vector<Cell>& args);
+
+    //! Return the value buffer of the last multiple values result.
+    const std::vector<Cell>& values() const noexcept { return mvalues; }
+
+    //! Start a non-local exit to the innermost active exception handler escape point.
+    //! Return false, if there is no active exception handler.
+    bool raise(const std::vector<Cell>& args);
+
+    /**
+     * Call the innermost active exception handler with the raised object, where
+     * the handler itself is not active during the call.
+     *
+     * @param result Handler result.
+     * @return False, if there is no active exception handler.
+     */
+    bool raise_continuable(const SymenvPtr& env, const Cell& obj, Cell& result);
+
+    //! Predicate returns true, while the evaluator is unwinding to an escape point.
+    bool is_unwinding() const noexcept { return unwind_target; }
+
+    //! Return the argument value or throw an ::unwind_exception, if the evaluator is
+    //! unwinding. Used by C++ functions, which use the results of their scheme callbacks.
+    const Cell& unwind_check(const Cell& val) const
+    {
+        return unwind_target ? (throw unwind_exception{}, val) : val;
+    }
 
     /**
      * Evaluate each expression in argument list up the last, which
@@ -199,6 +462,47 @@ public:
     Cell syntax_begin(const SymenvPtr& env, Cell args);
 
 protected:
+    /**
+     * Return a new closure of a lambda expression, which captures the argument environment.
+     *
+     * The formal parameter list is validated only at the first evaluation, which stores
+     * a closure template by the cons-cell of the lambda body, so that each further evaluation
+     * of the lambda expression only allocates the new closure. The expression itself is
+     * left unchanged.
+     *
+     * @param env  Symbol environment to capture.
+     * @param expr Cons-cell, whose cdr is the lambda body expression list.
+     * @param args Formal parameter list.
+     */
+    Procedure closure(const SymenvPtr& env, const Cell& expr, const Cell& args, bool is_macro = false);
+
+    /**
+     * Scheme syntax syntax-rules.
+     *
+     * @verbatim
+     * (syntax-rules (<literal> ...) (<pattern> <template>) ...)
+     * (syntax-rules <ellipsis> (<literal> ...) (<pattern> <template>) ...)
+     * @endverbatim
+     *
+     * The syntax rules are compiled once at the first evaluation into a macro template,
+     * which is stored by the cons-cell of the argument list.
+     *
+     * @param args (<literal> ...) (<pattern> <template>) ...
+     * @return A new macro, capturing the environment argument.
+     */
+    Procedure syntax_rules(const SymenvPtr& env, const Cell& args);
+
+    /**
+     * Release all unreachable cons-cells and reset the exhausted memory budget, if an
+     * allocation exceeded the budget. Cons-cells are only released between two top-level
+     * expressions of the outermost read-eval-print loop or loaded file, where
+     * the evaluator doesn't hold any cons-cell references outside of the environment
+     * and the explicit stacks of suspended coroutines.
+     * The pooled memory of leaf procedure call frames is handed back to the memory budget,
+     * if no frame is live.
+     */
+    void recover_memory(const SymenvPtr& env);
+
     Cell syntax_if(const SymenvPtr& env, const Cell& args);
 
     /**
@@ -211,33 +515,188 @@ protected:
      *          |  (<test> => <expression> ...)
      *          |  (else  <expression> ...)
      * @endverbatim
+     *
+     * @param[out] receiver Receiver procedure of a (<test> => <expression>) clause,
+     *                      to call in tail position with the returned test value, or none.
+     * @param[out] is_value True, if the returned cell is the value of the cond expression
+     *                      instead of the expression to evaluate in tail position.
      */
-    Cell syntax_cond(const SymenvPtr& env, Cell args);
+    Cell syntax_cond(const SymenvPtr& env, Cell args, Cell& receiver, bool& is_value);
 
     Cell syntax_when(const SymenvPtr& env, Cell args);
 
+    /**
+     * Scheme syntax quasiquote.
+     *
+     * Compile the template of a quasiquote expression into a constructor expression
+     * and replace the quasiquote expression in place by @verbatim (begin <constructor>) @endverbatim
+     * The constructor only copies the list spine up to the last unquoted expression
+     * and shares all constant parts with the template.
+     *
+     * @param expr (quasiquote <template>)
+     * @return The constructor expression.
+     */
+    Cell syntax_quasiquote(const Cell& expr);
+
     Cell syntax_unless(const SymenvPtr& env, Cell args);
 
     Cell syntax_and(const SymenvPtr& env, Cell args);
 
-    Cell syntax_or(const SymenvPtr& env, Cell args);
+    //! Scheme syntax or, which sets is_value, if the returned cell is the value of the
+    //! or expression instead of the expression to evaluate in tail position.
+    Cell syntax_or(const SymenvPtr& env, Cell args, bool& is_value);
+
+    /**
+     * Scheme syntax receive.
+     *
+     * @verbatim
+     * (receive <formals> <expression> <body>)
+     * @endverbatim
+     *
+     * Bind the values of the expression to the formal parameters in a new child
+     * environment, which replaces the argument environment.
+     * @return The body to evaluate at the call site.
+     */
+    Cell syntax_receive(SymenvPtr& env, const Cell& args);
+
+    /**
+     * Scheme syntax let-values.
+     *
+     * @verbatim
+     * (let-values ((<formals> <expression>) ...) <body>)
+     * @endverbatim
+     */
+    Cell syntax_let_values(SymenvPtr& env, const Cell& args);
+
+    /**
+     * Scheme syntax define-record-type.
+     *
+     * @verbatim
+     * (define-record-type <name> (<constructor> <field> ...) <pred> (<field> <accessor> [<modifier>]) ...)
+     * @endverbatim
+     *
+     * Define a new record type descriptor and native functions to construct a record,
+     * to test for a record of the type, and to read or write a record field by its
+     * slot index after a single type check.
+     */
+    void syntax_define_record_type(const SymenvPtr& env, const Cell& args);
 
 private:
+    friend class Compiler;
     friend class GCollector;
+    friend class Procedure;
+    friend class Coroutine;
+    friend class Scheduler;
+    struct Expander;
     static constexpr size_t dflt_bucket_count = 1024; //<! Initial default hash table bucket count.
     static constexpr size_t dflt_gccycle_count = 10000; //<! GC cycle after dflt_gccycle_count cons-cell allocations.
+    static constexpr size_t dflt_frame_size = 512; //<! Estimated native stack bytes of a nested evaluation.
+    static constexpr size_t dflt_max_depth = 100000; //<! Default nesting depth limit of non-tail evaluations.
+    static constexpr size_t dflt_fuel_slice = 1024; //<! Fuel units between two budget checks.
+
+    MemoryBudget budget; //!< Byte limit and accounting of all interpreter allocations.
+    std::pmr::memory_resource* mres = &budget; //!< Memory resource of all interpreter allocations.
+
+    //! Pool of recycled memory blocks for leaf procedure call frames, which is
+    //! released between two top-level expressions.
+    FramePool frames{ &budget };
+    size_t toplevel_depth = 0; //!< Nesting depth of read-eval-print loops and loaded files.
+    size_t expand_count = 0; //!< Number of in place macro expansions.
+    size_t bind_count = 0; //!< Number of global bindings, which might change the analysis of lambda expressions.
+    size_t eval_depth = 0; //!< Nesting depth of evaluations.
+    size_t max_depth = dflt_max_depth; //!< Nesting depth limit of evaluations.
+    const char* stack_start = nullptr; //!< Lowest native stack address of the evaluating task.
+    std::ptrdiff_t stack_reserve = PLATFORM_STACK_RESERVE; //!< Native stack bytes kept free below nested evaluations.
+
+    /**
+     * Throw a ::depth_exceeded exception, if a nested evaluation would exceed the
+     * nesting depth limit or the native stack. The stack start and reserve are
+     * determined by the outermost evaluation.
+     */
+    void check_depth()
+    {
+        char mark;
+        if (!eval_depth) {
+            stack_start = PLATFORM_STACK_START(&mark);
+            stack_reserve = std::min<std::ptrdiff_t>(PLATFORM_STACK_RESERVE, (&mark - stack_start) / 4);
+        }
+        eval_depth < max_depth || (void(throw depth_exceeded{ max_depth }), 0);
+        &mark - stack_start >= stack_reserve || (void(throw depth_exceeded{ eval_depth }), 0);
+    }
+
+    size_t max_fuel = 0; //!< Fuel of each top-level evaluation or zero for unlimited.
+    std::chrono::milliseconds max_time{ 0 }; //!< Time limit of each top-level evaluation or zero.
+    size_t fuel = 0; //!< Remaining fuel at the start of the current slice or zero for unlimited.
+    size_t slice = dflt_fuel_slice; //!< Fuel units of the current slice.
+    size_t ticks = dflt_fuel_slice; //!< Remaining fuel units of the current slice.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    //! Restart the execution budget for a new top-level evaluation.
+    void restart_budget();
+
+    //! Check the execution budget at the end of a fuel slice and start the next slice.
+    void preempt();
+
+    //! Evaluate the top-level expressions of a loaded file or script at an environment. The
+    //! reader function assigns the next expression to its argument or returns false at the end.
+    template <typename Reader>
+    void load(const SymenvPtr& env, bool expand, Reader&& read);
+
+    Coroutine* coroutine = nullptr; //!< Running coroutine or null-pointer.
+    std::pmr::vector<Coroutine*> coroutines{ mres }; //!< All coroutines, whose cells are marked by the garbage collector.
+
+    size_t escape_count = 0; //!< Counter for unique escape point identifiers.
+    size_t unwind_target = 0; //!< Escape point of the current non-local exit or zero.
+
+    //! Restore optimised and invalidate compiled code, lambda analyses and rest parameter lists, which
+    //! depend on the global binding of argument symbol.
+    void deoptimize(const Symbol& sym);
+
+    //! Bind a single value or the values of a multiple values result to a formal parameter list.
+    void bind_values(const SymenvPtr& env, Cell formals, const Cell& val);
+
+    //! Raise the error of a multiple values result of an expression in a single value context.
+    Cell raise_values(const Cell& expr);
+
+    //! The symbol table is declared before all members, which hold symbols or cells, so
+    //! that they are destroyed first and release their symbols into the symbol table.
+    Symtab symtab{ dflt_bucket_count, mres };
+    size_t symbol_count = 0; //!< Counter for new unique symbol names.
+
+    std::vector<std::pair<size_t, Cell>> escapes; //!< Active escape points and their exception handlers.
+    std::vector<Cell> unwind_args; //!< Exit values of the current non-local exit.
+    std::vector<Cell> mvalues; //!< Value buffer of the last multiple values result.
+
+    //! Unbound operator symbols of pending lambda expressions.
+    std::pmr::unordered_set<Symbol, Symbol::hash> pending_deps{ mres };
+
+    //! Global operator symbols, which the rest parameter lists of leaf procedures are passed to.
+    std::pmr::unordered_set<Symbol, Symbol::hash> rest_deps{ mres };
+    size_t rest_epoch = 1; //!< Incremented, whenever a global symbol of rest_deps is redefined.
 
     using standard_port = StandardPort<Char>;
-    PortPtr m_stdin = std::make_shared<standard_port>(standard_port::in);
-    PortPtr m_stdout = std::make_shared<standard_port>(standard_port::out);
+    PortPtr m_stdin = make_shared<standard_port>(standard_port::in);
+    PortPtr m_stdout = make_shared<standard_port>(standard_port::out);
 
-    std::list<Cons> store;
+    std::pmr::list<Cons> store{ mres };
     size_t store_size = 0;
 
-    Symtab symtab{ dflt_bucket_count };
+    //! Closure and macro templates of evaluated lambda and syntax-rules expressions by the cons-cell
+    //! of their body. Templates of unreachable cons-cells are dropped by the garbage collector.
+    std::pmr::unordered_map<Cons*, Procedure> templates{ mres };
+
     SymenvPtr topenv = nullptr;
 public:
     GCollector gc;
+
+    //! Optional optimiser of closed lambda expressions, disabled by default.
+    Optimizer optimizer{ mres };
+
+    //! Optional compiler of numeric procedures, disabled by default.
+    Compiler compiler{ mres };
+
+    //! Scheduler of the green threads, declared last to finish them first.
+    Scheduler scheduler{ *this };
 };
 
 } // namespace pscm
@@ -9,12 +9,16 @@
 #ifndef SYMBOL_HPP
 #define SYMBOL_HPP
 
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "flatmap.hpp"
 #include "utils.hpp"
 
 namespace pscm {
@@ -28,57 +32,114 @@ struct symenv_exception;
  * surjective mapping between values of type T to symbols of
  * type Symtab<T>::Symbol.
  *
+ * Symbol values are stored together with their precomputed hash value and a
+ * dense 32-bit symbol id in a chunked arena, which never moves its entries.
+ * The arena is indexed by an open addressing hash table of symbol ids, so that
+ * a lookup or insert requires a single hash computation and no per symbol
+ * table node allocation.
+ *
+ * The arena, the index and the symbol values of an allocator aware type T
+ * are allocated from a polymorphic memory resource.
+ *
+ * Each entry counts the Symbol handles referring to it. An entry without any
+ * handle is unreachable, it is removed from the index and its arena slot and
+ * symbol id are reused by the next new symbol. As long as a symbol is alive,
+ * equal values map to the identical symbol. Symbols must not outlive their
+ * symbol table.
+ *
  * @tparam T     Value type of symbol, like std::string, char, int,...
  * @tparam Hash  Hash function object that implements a has function for values of type T.
  * @tparam Equal Function object for performing comparison on values of type T.
  */
 template <typename T, typename Hash = std::hash<T>, typename Equal = std::equal_to<T>>
 struct SymbolTable {
-    //! A Symbol as handle to a pointer of type T into the symbol table
+
+    //! Symbol table arena entry.
+    struct Entry {
+        T value; //!< Symbol value.
+        size_t hash; //!< Precomputed hash value of the symbol value.
+        uint32_t id; //!< Dense symbol id, equal to the entry position in the arena.
+        uint32_t refs; //!< Number of symbol handles or zero for a free entry.
+        SymbolTable* table; //!< Owning symbol table.
+    };
+
+    //! A Symbol as reference counting handle to an entry of the symbol table.
     struct Symbol {
         using value_type = T;
 
         Symbol() = delete;
-        Symbol(const Symbol&) = default;
-        Symbol(Symbol&&) = default;
-
-        Symbol& operator=(const Symbol&) = default;
-        Symbol& operator=(Symbol&& s) = default;
+        Symbol(const Symbol& sym) noexcept
+            : ptr{ sym.ptr }
+        {
+            ++ptr->refs;
+        }
+        //! Take over the entry reference without counting, the moved-from symbol
+        //! may only be destroyed or assigned.
+        Symbol(Symbol&& sym) noexcept
+            : ptr{ std::exchange(sym.ptr, nullptr) }
+        {
+        }
+        ~Symbol()
+        {
+            if (ptr && !--ptr->refs)
+                ptr->table->release(*ptr);
+        }
+        Symbol& operator=(const Symbol& sym)
+        {
+            Symbol tmp{ sym };
+            std::swap(ptr, tmp.ptr);
+            return *this;
+        }
+        Symbol& operator=(Symbol&& sym) noexcept
+        {
+            std::swap(ptr, sym.ptr);
+            return *this;
+        }
 
         //! Return a constant refererence to the symbol value T.
-        const T& value() const noexcept { return *ptr; }
+        const T& value() const noexcept { return ptr->value; }
+
+        //! Return the dense symbol id in range [0, SymbolTable::capacity()).
+        uint32_t id() const noexcept { return ptr->id; }
 
         //! Equality predicates.
         bool operator==(const Symbol& sym) const noexcept { return ptr == sym.ptr; }
         bool operator!=(const Symbol& sym) const noexcept { return ptr != sym.ptr; }
-        bool operator<(const Symbol& sym) const noexcept { return ptr < sym.ptr; }
+        bool operator<(const Symbol& sym) const noexcept { return ptr->id < sym.ptr->id; }
 
-        struct hash : private std::hash<const T*> {
+        //! Return the precomputed hash value of the symbol value.
+        struct hash {
             using argument_type = Symbol;
             using result_type = std::size_t;
 
             result_type operator()(const Symbol& sym) const noexcept
             {
-                return std::hash<const T*>::operator()(sym.ptr);
+                return sym.ptr->hash;
             }
         };
 
     private:
-        Symbol(const T& val)
-            : ptr{ &val }
+        Symbol(Entry& entry) noexcept
+            : ptr{ &entry }
         {
+            ++ptr->refs;
         }
         friend struct SymbolTable; //! needs access to private constructor
-        const T* ptr;
+        Entry* ptr;
     };
     /**
      * Construct a symbol table
      * @param bucket_count Initial hash table bucket count hint.
+     * @param mres         Memory resource for all symbol table allocations.
      */
-    SymbolTable(size_t bucket_count = 0)
-        : table(bucket_count)
+    SymbolTable(size_t bucket_count = 0, std::pmr::memory_resource* mres = std::pmr::get_default_resource())
+        : arena{ mres }
+        , index(capacity(bucket_count), 0, mres)
+        , free{ mres }
     {
     }
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
 
     /**
      * Return a new or previously constructed symbol.
@@ -86,12 +147,119 @@ struct SymbolTable {
      * @return Symbol of type Symtab<T>::Symbol.
      */
     template <typename Val>
-    Symbol operator[](Val&& val) { return *table.emplace(std::forward<Val>(val)).first; }
+    Symbol operator[](Val&& val)
+    {
+        if constexpr (std::is_same_v<std::decay_t<Val>, T>)
+            return intern(std::forward<Val>(val));
+        else
+            return intern(make_value(std::forward<Val>(val)));
+    }
 
-    size_t size() { return table.size(); }
+    //! Return the number of live symbols.
+    size_t size() const { return arena.size() - free.size(); }
+
+    //! Return the number of live and released symbol table entries.
+    size_t capacity() const { return arena.size(); }
 
 private:
-    std::unordered_set<T, Hash, Equal> table;
+    //! Construct a symbol value, allocated from the symbol table memory resource.
+    template <typename... Args>
+    T make_value(Args&&... args)
+    {
+        if constexpr (std::uses_allocator_v<T, std::pmr::polymorphic_allocator<T>>)
+            return T(std::forward<Args>(args)..., std::pmr::polymorphic_allocator<T>{ arena.get_allocator() });
+        else
+            return T(std::forward<Args>(args)...);
+    }
+
+    //! Return the smallest power of two index capacity for count symbols at a maximal load of 1/2.
+    static size_t capacity(size_t count)
+    {
+        size_t cap = 16;
+
+        while (cap < 2 * count)
+            cap *= 2;
+
+        return cap;
+    }
+
+    //! Lookup a symbol value or insert it at the first free index slot.
+    template <typename Val>
+    Symbol intern(Val&& val)
+    {
+        const size_t hash = Hash{}(val), mask = index.size() - 1;
+        size_t pos = hash & mask;
+
+        for (uint32_t slot; (slot = index[pos]); pos = (pos + 1) & mask) {
+            Entry& entry = arena[slot - 1];
+
+            if (entry.hash == hash && Equal{}(entry.value, val))
+                return entry;
+        }
+        Entry* entry;
+
+        if (free.empty()) {
+            arena.push_back({ make_value(std::forward<Val>(val)), hash, static_cast<uint32_t>(arena.size()), 0, this });
+            entry = &arena.back();
+        } else { // reuse a released entry
+            entry = &arena[free.back()];
+            free.pop_back();
+            entry->value = make_value(std::forward<Val>(val));
+            entry->hash = hash;
+        }
+        index[pos] = entry->id + 1;
+        Symbol sym{ *entry };
+
+        if (2 * size() > index.size())
+            rehash(2 * index.size());
+
+        return sym;
+    }
+
+    //! Remove an unreferenced entry from the index and release its value.
+    void release(Entry& entry)
+    {
+        const size_t mask = index.size() - 1;
+        size_t pos = entry.hash & mask;
+
+        while (index[pos] != entry.id + 1)
+            pos = (pos + 1) & mask;
+
+        // Backward shift deletion to close the gap in the probe sequence:
+        for (size_t next = (pos + 1) & mask; index[next]; next = (next + 1) & mask) {
+            const size_t home = arena[index[next] - 1].hash & mask;
+
+            if (((next - home) & mask) >= ((next - pos) & mask)) {
+                index[pos] = index[next];
+                pos = next;
+            }
+        }
+        index[pos] = 0;
+        entry.value = make_value();
+        free.push_back(entry.id);
+    }
+
+    //! Rebuild the open addressing index with a new power of two capacity.
+    void rehash(size_t cap)
+    {
+        index.assign(cap, 0);
+
+        for (const Entry& entry : arena) {
+            if (!entry.refs)
+                continue;
+
+            size_t pos = entry.hash & (cap - 1);
+
+            while (index[pos])
+                pos = (pos + 1) & (cap - 1);
+
+            index[pos] = entry.id + 1;
+        }
+    }
+
+    std::pmr::deque<Entry> arena; //!< Symbol entries with stable addresses.
+    std::pmr::vector<uint32_t> index; //!< Open addressing table of entry id + 1 or zero for a free slot.
+    std::pmr::vector<uint32_t> free; //!< Ids of released arena entries.
 };
 
 //! Exception to be thrown by template class SymbolEnv for unknown symbols.
@@ -113,6 +281,12 @@ private:
  *
  * A symbol environment associates symbols to values. Symbol value bindings
  * are unique per environment. Severel environments form a child-parent tree.
+ * The bindings are stored in a FlatMap, which keeps the few bindings of a
+ * procedure call frame inline without any further heap allocation.
+ *
+ * An environment might be created with a closed scope, a sorted list of all
+ * symbols, which this environment will ever bind. A closure, which doesn't
+ * reference any of these symbols, doesn't need to capture this environment.
  *
  * @tparam Sym Symbol type
  * @tparam T   Value type
@@ -124,22 +298,34 @@ public:
     using symbol_type = Sym;
     using value_type = T;
     using shared_type = std::shared_ptr<SymbolEnv>;
+    using scope_type = std::shared_ptr<const std::pmr::vector<Sym>>;
 
     using std::enable_shared_from_this<SymbolEnv>::shared_from_this;
     using std::enable_shared_from_this<SymbolEnv>::weak_from_this;
 
     //! Create a new empty symbol environment, optionally as a child
-    //! of the argument parent environment.
-    static shared_type create(const shared_type& parent = nullptr)
+    //! of the argument parent environment. The environment is allocated
+    //! from the argument memory resource.
+    static shared_type create(const shared_type& parent = nullptr,
+        std::pmr::memory_resource* mres = std::pmr::get_default_resource())
+    {
+        return std::allocate_shared<SymbolEnv>(allocator_type{ mres }, Passkey{}, parent, nullptr, mres);
+    }
+
+    //! Create a new empty child environment of the argument parent environment with
+    //! a closed scope of sorted symbols, or an open scope if null-pointer.
+    static shared_type create(const shared_type& parent, const scope_type& scope,
+        std::pmr::memory_resource* mres = std::pmr::get_default_resource())
     {
-        return shared_type{ new SymbolEnv{ parent } };
+        return std::allocate_shared<SymbolEnv>(allocator_type{ mres }, Passkey{}, parent, scope, mres);
     }
 
     //! Create a new symbol environment and initialize it with (symbol,value)-pairs
     static shared_type create(std::initializer_list<std::pair<Sym, T>> args,
-        const shared_type& parent = nullptr)
+        const shared_type& parent = nullptr,
+        std::pmr::memory_resource* mres = std::pmr::get_default_resource())
     {
-        return shared_type{ new SymbolEnv{ args, parent } };
+        return std::allocate_shared<SymbolEnv>(allocator_type{ mres }, Passkey{}, args, parent, mres);
     }
 
     //! Insert a new symbol and value or reassigns a bound value of an existing symbol
@@ -197,6 +383,30 @@ public:
 
         throw symenv_exception{ sym };
     }
+
+    //! Lookup a symbol in this or any reachable parent environment and
+    //! return a pointer to its bound value or a null-pointer if unknown.
+    const T* find(const Sym& sym) const noexcept
+    {
+        const SymbolEnv* senv = this;
+
+        do {
+            auto iter = senv->table.find(sym);
+
+            if (iter != senv->table.end())
+                return &iter->second;
+
+        } while ((senv = senv->next.get()));
+
+        return nullptr;
+    }
+
+    //! Return the parent environment or null-pointer for a top-environment.
+    const shared_type& parent() const noexcept { return next; }
+
+    //! Return the closed scope of this environment or null-pointer for an open scope.
+    const scope_type& scope() const noexcept { return closed; }
+
     /**
      * Cursor as (begin,end)-iterator range to iterate over all (symbol,value)-pairs
      * of this environment and to move to the next parent environment.
@@ -229,21 +439,32 @@ public:
     Cursor cursor() const { return Cursor{ weak_from_this() }; }
 
 private:
+    using allocator_type = std::pmr::polymorphic_allocator<SymbolEnv>;
+
+    //! Restrict construction to the create() functions.
+    struct Passkey {
+        explicit Passkey() = default;
+    };
+
+public:
     /**
      * Construct a symbol environment as top- or sub-environment.
      * @param parent Optional, unless null-pointer. construct a sub-environment connected
      *               to the parent environment or a top-environment otherwise.
      */
-    SymbolEnv(const shared_type& parent = nullptr)
+    SymbolEnv(Passkey, const shared_type& parent, const scope_type& scope, std::pmr::memory_resource* mres)
         : next{ parent }
+        , closed{ scope }
+        , table{ 0, mres }
     {
     }
 
     //! Construct a new top or child environment and initialize it with {symbol,value} pairs
     //! from initializer list.
-    SymbolEnv(std::initializer_list<std::pair<Sym, T>> args, const shared_type& parent = nullptr)
+    SymbolEnv(Passkey, std::initializer_list<std::pair<Sym, T>> args, const shared_type& parent,
+        std::pmr::memory_resource* mres)
         : next{ parent }
-        , table{ args.size() }
+        , table{ args.size(), mres }
     {
         for (auto& [sym, val] : args)
             add(sym, val);
@@ -251,7 +472,8 @@ private:
 
 private:
     const std::shared_ptr<SymbolEnv> next = nullptr;
-    std::unordered_map<Sym, T, Hash> table;
+    const scope_type closed = nullptr; //!< All symbols ever bound or null-pointer if unknown.
+    FlatMap<Sym, T, Hash> table;
 };
 
 } // namespace pscm
@@ -0,0 +1,581 @@
+/********************************************************************************/ /**
+ * @file syntax.cpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#include <algorithm>
+
+#include "scheme.hpp"
+#include "syntax.hpp"
+
+namespace pscm {
+
+//! Matched input of a pattern variable or, for a variable of an ellipsis pattern,
+//! the sequence of matches of each repetition.
+struct SyntaxRules::Match {
+    using allocator_type = std::pmr::polymorphic_allocator<Match>;
+
+    explicit Match(const allocator_type& alloc)
+        : items{ alloc }
+    {
+    }
+    Match(const Match& match, const allocator_type& alloc)
+        : value{ match.value }
+        , items{ match.items, alloc }
+    {
+    }
+    Match(Match&& match, const allocator_type& alloc)
+        : value{ std::move(match.value) }
+        , items{ std::move(match.items), alloc }
+    {
+    }
+    Match& operator=(Match&& match) = default;
+
+    Cell value;
+    std::pmr::vector<Match> items;
+};
+
+/**
+ * Compiler of the syntax rule patterns and templates into the instruction table.
+ *
+ * The items of a list or vector node are compiled into consecutive nodes, followed by
+ * the nodes of all nested items. Constant template parts are folded into a single datum node.
+ */
+struct SyntaxRules::Compiler {
+    Compiler(Scheme& scm, SyntaxRules& self)
+        : self{ self }
+        , topenv{ scm.getenv() }
+        , underscore{ scm.symbol("_") }
+        , quote{ scm.symbol("quote") }
+        , lambda{ scm.symbol("lambda") }
+        , define{ scm.symbol("define") }
+        , binding_forms{ scm.symbol("let"), scm.symbol("let*"), scm.symbol("letrec"), scm.symbol("letrec*"), scm.symbol("do") }
+    {
+    }
+
+    void rule(const Cell& rule)
+    {
+        (is_pair(rule) && is_pair(car(rule)) && is_pair(cdr(rule)) && is_nil(cddr(rule)))
+            || (void(throw std::invalid_argument("syntax-rules - invalid syntax rule")), 0);
+
+        names.clear();
+        bound.clear();
+        Rule r{ node(), 0, self.depths.size(), 0 };
+        pattern(r.pattern, cdr(car(rule)), 0); // the macro keyword position is ignored
+        r.size = names.size();
+        binders(cadr(rule));
+        r.tmpl = node();
+        tmpl(r, r.tmpl, cadr(rule), 0, false);
+        self.rules.push_back(r);
+    }
+
+private:
+    //! Scanned list or vector item and the number of following ellipses.
+    struct Item {
+        Cell cell;
+        unsigned repeat;
+    };
+
+    SyntaxRules& self;
+    SymenvPtr topenv;
+    Symbol underscore, quote, lambda, define;
+    std::vector<Symbol> binding_forms; //!< Keywords of let and do forms.
+    std::vector<Symbol> names; //!< Pattern variables of the current rule.
+    std::vector<Symbol> bound; //!< Inserted symbols, which are bound by the current template.
+    bool is_escaped = false; //!< Compiling a (... <template>) escape.
+
+    static bool contains(const std::vector<Symbol>& vec, const Symbol& sym)
+    {
+        return std::find(vec.begin(), vec.end(), sym) != vec.end();
+    }
+
+    //! Return true, if a symbol is globally bound to a syntactic keyword or primary function.
+    bool is_global(const Symbol& sym) const
+    {
+        const Cell* val = topenv ? topenv->find(sym) : nullptr;
+        return val && is_intern(*val);
+    }
+
+    //! Collect the inserted symbols of a template, which are bound by a lambda, define, let or do form.
+    void binders(const Cell& tpl)
+    {
+        if (is_vector(tpl))
+            for (const Cell& cell : *get<VectorPtr>(tpl))
+                binders(cell);
+
+        if (!is_pair(tpl))
+            return;
+
+        if (is_symbol(car(tpl)) && is_pair(cdr(tpl))) {
+            const Symbol& op = get<Symbol>(car(tpl));
+            Cell arg = cadr(tpl);
+
+            if (op == quote)
+                return;
+
+            if (op == lambda || (op == define && is_pair(arg)))
+                bind_list(arg);
+
+            else if (op == define)
+                bind(arg);
+
+            else if (contains(binding_forms, op)) {
+                if (is_symbol(arg) && is_pair(cddr(tpl))) { // named let
+                    bind(arg);
+                    arg = caddr(tpl);
+                }
+                for (/* */; is_pair(arg); arg = cdr(arg))
+                    if (is_pair(car(arg)))
+                        bind(caar(arg));
+            }
+        }
+        for (Cell iter = tpl; is_pair(iter); iter = cdr(iter))
+            binders(car(iter));
+    }
+
+    void bind(const Cell& cell)
+    {
+        if (is_symbol(cell) && !is_ellipsis(cell) && !contains(names, get<Symbol>(cell)))
+            bound.push_back(get<Symbol>(cell));
+    }
+
+    void bind_list(Cell list)
+    {
+        for (/* */; is_pair(list); list = cdr(list))
+            bind(car(list));
+        bind(list);
+    }
+
+    size_t node()
+    {
+        self.nodes.emplace_back();
+        return self.nodes.size() - 1;
+    }
+
+    bool is_ellipsis(const Cell& cell) const
+    {
+        return !is_escaped && is_symbol(cell) && get<Symbol>(cell) == self.ellipsis;
+    }
+
+    //! Scan list items and count the ellipses following each item. Return the list tail.
+    Cell scan(Cell list, std::vector<Item>& items) const
+    {
+        for (/* */; is_pair(list); list = cdr(list))
+            if (is_ellipsis(car(list)))
+                (!items.empty() && ++items.back().repeat)
+                    || (void(throw std::invalid_argument("syntax-rules - misplaced ellipsis")), 0);
+            else
+                items.push_back({ car(list), 0 });
+
+        return list;
+    }
+
+    //! Reserve consecutive item nodes of a list or vector node.
+    size_t reserve(size_t at, Node::Op op, const std::vector<Item>& items, bool tail)
+    {
+        size_t first = self.nodes.size();
+        self.nodes.resize(first + items.size() + tail);
+
+        Node& node = self.nodes[at];
+        node.op = op;
+        node.index = first;
+        node.count = items.size();
+        node.tail = tail;
+
+        for (size_t i = 0; i < items.size(); ++i)
+            self.nodes[first + i].repeat = items[i].repeat;
+
+        return first;
+    }
+
+    void pattern(size_t at, const Cell& pat, unsigned depth)
+    {
+        self.nodes[at].vars = self.slots.size();
+
+        if (is_symbol(pat)) {
+            const Symbol& sym = get<Symbol>(pat);
+            Node& node = self.nodes[at];
+
+            if (is_ellipsis(pat))
+                throw std::invalid_argument("syntax-rules - misplaced ellipsis");
+
+            if (sym == underscore)
+                node.op = Node::Op::any;
+
+            else if (std::find(self.literals.begin(), self.literals.end(), sym) != self.literals.end()) {
+                node.op = Node::Op::symbol;
+                node.value = sym;
+            } else {
+                !contains(names, sym)
+                    || (void(throw std::invalid_argument("syntax-rules - duplicate pattern variable")), 0);
+
+                node.op = Node::Op::var;
+                node.index = names.size();
+                names.push_back(sym);
+                self.depths.push_back(depth);
+                self.slots.push_back(node.index);
+            }
+        } else if (is_pair(pat) || is_vector(pat)) {
+            std::vector<Item> items;
+            Cell tail = nil;
+
+            if (is_pair(pat))
+                tail = scan(pat, items);
+            else
+                for (const Cell& cell : *get<VectorPtr>(pat))
+                    if (is_ellipsis(cell))
+                        (!items.empty() && ++items.back().repeat)
+                            || (void(throw std::invalid_argument("syntax-rules - misplaced ellipsis")), 0);
+                    else
+                        items.push_back({ cell, 0 });
+
+            size_t ellipses = 0;
+            for (const Item& item : items)
+                ellipses += item.repeat;
+
+            ellipses <= 1 || (void(throw std::invalid_argument("syntax-rules - misplaced ellipsis")), 0);
+
+            size_t first = reserve(at, is_pair(pat) ? Node::Op::list : Node::Op::vector, items, !is_nil(tail));
+            self.nodes[at].ellipsis = ellipses;
+
+            for (size_t i = 0; i < items.size(); ++i)
+                pattern(first + i, items[i].cell, depth + items[i].repeat);
+
+            if (!is_nil(tail))
+                pattern(first + items.size(), tail, depth);
+        } else {
+            self.nodes[at].op = Node::Op::datum;
+            self.nodes[at].value = pat;
+        }
+        self.nodes[at].vars_end = self.slots.size();
+    }
+
+    void tmpl(const Rule& rule, size_t at, const Cell& tpl, unsigned depth, bool quoted)
+    {
+        self.nodes[at].vars = self.slots.size();
+
+        if (is_symbol(tpl)) {
+            const Symbol& sym = get<Symbol>(tpl);
+            Node& node = self.nodes[at];
+            auto pos = std::find(names.begin(), names.end(), sym);
+
+            if (pos != names.end()) {
+                node.op = Node::Op::var;
+                node.index = static_cast<size_t>(pos - names.begin());
+
+                self.depths[rule.depth + node.index] <= depth
+                    || (void(throw std::invalid_argument("syntax-rules - missing ellipsis in template")), 0);
+
+                self.slots.push_back(node.index);
+            } else if (is_ellipsis(tpl))
+                throw std::invalid_argument("syntax-rules - misplaced ellipsis");
+            else {
+                node.op = quoted ? Node::Op::datum
+                    : contains(bound, sym) ? Node::Op::symbol
+                    : is_global(sym)       ? Node::Op::free
+                                           : Node::Op::datum;
+                node.value = sym;
+            }
+        } else if (is_pair(tpl) && is_ellipsis(car(tpl))) { // (... <template>)
+            (is_pair(cdr(tpl)) && is_nil(cddr(tpl)))
+                || (void(throw std::invalid_argument("syntax-rules - invalid ellipsis escape")), 0);
+
+            is_escaped = true;
+            tmpl(rule, at, cadr(tpl), depth, quoted);
+            is_escaped = false;
+
+        } else if (is_pair(tpl) || is_vector(tpl)) {
+            std::vector<Item> items;
+            Cell tail = nil;
+
+            if (is_pair(tpl)) {
+                quoted = quoted || (is_symbol(car(tpl)) && get<Symbol>(car(tpl)) == quote);
+                tail = scan(tpl, items);
+            } else
+                for (const Cell& cell : *get<VectorPtr>(tpl))
+                    if (is_ellipsis(cell))
+                        (!items.empty() && ++items.back().repeat)
+                            || (void(throw std::invalid_argument("syntax-rules - misplaced ellipsis")), 0);
+                    else
+                        items.push_back({ cell, 0 });
+
+            size_t first = reserve(at, is_pair(tpl) ? Node::Op::list : Node::Op::vector, items, !is_nil(tail));
+            bool constant = true;
+
+            for (size_t i = 0; i < items.size(); ++i) {
+                tmpl(rule, first + i, items[i].cell, depth + items[i].repeat, quoted);
+                constant = constant && !items[i].repeat && self.nodes[first + i].op == Node::Op::datum;
+            }
+            if (!is_nil(tail)) {
+                tmpl(rule, first + items.size(), tail, depth, quoted);
+                constant = constant && self.nodes[first + items.size()].op == Node::Op::datum;
+            }
+            if (constant) { // share the constant template part
+                self.nodes.resize(first);
+                self.nodes[at].op = Node::Op::datum;
+                self.nodes[at].value = tpl;
+            }
+        } else {
+            self.nodes[at].op = Node::Op::datum;
+            self.nodes[at].value = tpl;
+        }
+        self.nodes[at].vars_end = self.slots.size();
+    }
+};
+
+/**
+ * Builder of a macro expansion from the instruction table of a template.
+ *
+ * The builder holds the current match of each pattern variable and the number of
+ * ellipses, which are already unrolled for this variable.
+ */
+struct SyntaxRules::Builder {
+    Builder(Scheme& scm, const SymenvPtr& senv, const SymenvPtr& env, const SyntaxRules& self, const Rule& rule,
+        const std::pmr::vector<Match>& slots)
+        : scm{ scm }
+        , senv{ senv }
+        , env{ env }
+        , self{ self }
+        , depths{ self.depths.data() + rule.depth }
+        , current{ slots.get_allocator() }
+        , level(slots.size(), 0, slots.get_allocator())
+        , renamed{ slots.get_allocator() }
+    {
+        current.reserve(slots.size());
+        for (const Match& match : slots)
+            current.push_back(&match);
+    }
+
+    Cell build(size_t index)
+    {
+        const Node& node = self.nodes[index];
+
+        switch (node.op) {
+        case Node::Op::var:
+            return current[node.index]->value;
+
+        case Node::Op::symbol:
+            return rename(get<Symbol>(node.value));
+
+        case Node::Op::free: { // insert the definition binding, if the macro call rebinds the symbol
+            const Cell* val = senv ? senv->find(get<Symbol>(node.value)) : nullptr;
+            return val && env && env->find(get<Symbol>(node.value)) != val ? *val : node.value;
+        }
+
+        case Node::Op::list: {
+            Cell head = nil;
+            Cons* last = nullptr;
+
+            items(node, [this, &head, &last](const Cell& item) {
+                Cons* cons = scm.cons(item, nil);
+                last ? void(get<1>(*last) = cons) : void(head = cons);
+                last = cons;
+            });
+            if (node.tail) {
+                Cell tail = build(node.index + node.count);
+                last ? void(get<1>(*last) = tail) : void(head = tail);
+            }
+            return head;
+        }
+        case Node::Op::vector: {
+            VectorPtr vec = scm.vec();
+            items(node, [&vec](const Cell& item) { vec->push_back(item); });
+            return vec;
+        }
+        default:
+            return node.value;
+        }
+    }
+
+private:
+    Scheme& scm;
+    const SymenvPtr& senv; //!< Environment of the macro definition.
+    const SymenvPtr& env; //!< Environment of the macro call.
+    const SyntaxRules& self;
+    const unsigned* depths; //!< Ellipsis depth of each pattern variable.
+    std::pmr::vector<const Match*> current; //!< Current match of each pattern variable.
+    std::pmr::vector<unsigned> level; //!< Number of unrolled ellipses of each pattern variable.
+    std::pmr::vector<std::pair<Symbol, Symbol>> renamed; //!< Renamed template symbols of this expansion.
+
+    //! Return the fresh replacement of an inserted template symbol for this expansion.
+    Cell rename(const Symbol& sym)
+    {
+        for (const auto& [from, to] : renamed)
+            if (from == sym)
+                return to;
+
+        renamed.emplace_back(sym, scm.symbol());
+        return renamed.back().second;
+    }
+
+    template <typename Append>
+    void items(const Node& node, Append&& append)
+    {
+        for (size_t i = node.index, end = node.index + node.count; i != end; ++i)
+            if (self.nodes[i].repeat)
+                repeat(i, self.nodes[i].repeat, append);
+            else
+                append(build(i));
+    }
+
+    //! Unroll an item template, followed by count ellipses, for each repetition
+    //! of its pattern variables with a not yet unrolled ellipsis depth.
+    template <typename Append>
+    void repeat(size_t index, unsigned count, Append& append)
+    {
+        const Node& node = self.nodes[index];
+        std::pmr::vector<size_t> vars{ current.get_allocator() };
+        std::pmr::vector<const Match*> outer{ current.get_allocator() };
+        size_t size = 0;
+
+        for (size_t i = node.vars; i != node.vars_end; ++i) {
+            size_t slot = self.slots[i];
+
+            if (depths[slot] > level[slot] && std::find(vars.begin(), vars.end(), slot) == vars.end()) {
+                (vars.empty() || current[slot]->items.size() == size)
+                    || (void(throw std::invalid_argument("syntax-rules - ellipsis length mismatch")), 0);
+
+                size = current[slot]->items.size();
+                vars.push_back(slot);
+                outer.push_back(current[slot]);
+                ++level[slot];
+            }
+        }
+        !vars.empty() || (void(throw std::invalid_argument("syntax-rules - no pattern variable in ellipsis template")), 0);
+
+        for (size_t i = 0; i < size; ++i) {
+            for (size_t j = 0; j < vars.size(); ++j)
+                current[vars[j]] = &outer[j]->items[i];
+
+            if (count > 1)
+                repeat(index, count - 1, append);
+            else
+                append(build(index));
+        }
+        for (size_t j = 0; j < vars.size(); ++j) {
+            current[vars[j]] = outer[j];
+            --level[vars[j]];
+        }
+    }
+};
+
+SyntaxRules::SyntaxRules(Scheme& scm, const Cell& literals, const Cell& rules)
+    : ellipsis{ is_symbol(literals) ? get<Symbol>(literals) : scm.symbol("...") }
+    , literals{ scm.memory_resource() }
+    , nodes{ scm.memory_resource() }
+    , slots{ scm.memory_resource() }
+    , depths{ scm.memory_resource() }
+    , rules{ scm.memory_resource() }
+{
+    Cell list = is_symbol(literals) ? car(rules) : literals;
+    Cell iter = is_symbol(literals) ? cdr(rules) : rules;
+
+    for (/* */; is_pair(list); list = cdr(list))
+        is_symbol(car(list)) ? this->literals.push_back(get<Symbol>(car(list)))
+                             : throw std::invalid_argument("syntax-rules - invalid literal");
+
+    Compiler compiler{ scm, *this };
+
+    for (/* */; is_pair(iter); iter = cdr(iter))
+        compiler.rule(car(iter));
+}
+
+Cell SyntaxRules::expand(Scheme& scm, const SymenvPtr& senv, const SymenvPtr& env, const Cell& expr) const
+{
+    // Most expansions don't need any heap allocation for the pattern variable matches:
+    std::byte buffer[1024];
+    std::pmr::monotonic_buffer_resource mres{ buffer, sizeof(buffer), scm.memory_resource() };
+    std::pmr::vector<Match> slots{ &mres };
+
+    for (const Rule& rule : rules) {
+        slots.clear();
+        slots.resize(rule.size);
+
+        if (match(rule.pattern, cdr(expr), slots))
+            return Builder{ scm, senv, env, *this, rule, slots }.build(rule.tmpl);
+    }
+    throw std::invalid_argument("invalid syntax - no matching syntax rule");
+}
+
+bool SyntaxRules::match(size_t index, const Cell& expr, std::pmr::vector<Match>& slots) const
+{
+    const Node& node = nodes[index];
+
+    switch (node.op) {
+    case Node::Op::any:
+        return true;
+
+    case Node::Op::var:
+        slots[node.index].value = expr;
+        return true;
+
+    case Node::Op::symbol:
+        return is_symbol(expr) && get<Symbol>(expr) == get<Symbol>(node.value);
+
+    case Node::Op::list: {
+        size_t size = 0;
+        Cell iter = expr;
+
+        for (/* */; is_pair(iter); iter = cdr(iter))
+            ++size;
+
+        iter = expr;
+        return match_items(node, size, [&iter]() { Cell item = car(iter); iter = cdr(iter); return item; }, slots)
+            && (node.tail ? match(node.index + node.count, iter, slots) : is_nil(iter));
+    }
+    case Node::Op::vector: {
+        if (!is_vector(expr))
+            return false;
+
+        const Vector& vec = *get<VectorPtr>(expr);
+        size_t pos = 0;
+
+        return match_items(node, vec.size(), [&vec, &pos]() { return vec[pos++]; }, slots)
+            && pos == vec.size();
+    }
+    default:
+        return is_equal(expr, node.value);
+    }
+}
+
+/**
+ * Match the items of a list or vector node against the next size input items. An ellipsis
+ * item matches all input items, which are not required by the following items, and collects
+ * the matches of its pattern variables into a sequence for each variable.
+ */
+template <typename Next>
+bool SyntaxRules::match_items(const Node& node, size_t size, Next&& next, std::pmr::vector<Match>& slots) const
+{
+    size_t fixed = node.count - node.ellipsis;
+
+    if (size < fixed || (!node.ellipsis && !node.tail && size != fixed))
+        return false;
+
+    for (size_t i = node.index, end = node.index + node.count; i != end; ++i) {
+        const Node& item = nodes[i];
+
+        if (!item.repeat) {
+            if (!match(i, next(), slots))
+                return false;
+            continue;
+        }
+        std::pmr::vector<Match> seqs{ slots.get_allocator() };
+        seqs.resize(item.vars_end - item.vars);
+
+        for (size_t n = size - fixed; n; --n) {
+            if (!match(i, next(), slots))
+                return false;
+
+            for (size_t k = item.vars; k != item.vars_end; ++k)
+                seqs[k - item.vars].items.push_back(std::move(slots[this->slots[k]]));
+        }
+        for (size_t k = item.vars; k != item.vars_end; ++k)
+            slots[this->slots[k]] = std::move(seqs[k - item.vars]);
+    }
+    return true;
+}
+
+} // namespace pscm
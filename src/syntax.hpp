@@ -0,0 +1,113 @@
+/********************************************************************************/ /**
+ * @file syntax.hpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#ifndef SYNTAX_HPP
+#define SYNTAX_HPP
+
+#include <memory_resource>
+#include <vector>
+
+#include "cell.hpp"
+
+namespace pscm {
+
+class Scheme;
+
+/**
+ * Compiled transformer of a syntax-rules macro.
+ *
+ * @verbatim
+ * (syntax-rules (<literal> ...) (<pattern> <template>) ...)
+ * (syntax-rules <ellipsis> (<literal> ...) (<pattern> <template>) ...)
+ * @endverbatim
+ *
+ * Each pattern is compiled once into a table of match instructions and each template
+ * into a table of constructor instructions. A macro call is expanded by matching the
+ * call against the instruction table of each pattern until the first match and by
+ * building the expansion from the instruction table of the corresponding template.
+ * Constant template parts, without pattern variables and template symbols, are shared
+ * with the template.
+ *
+ * Symbols inserted by a template, which are bound by a lambda, define, let or do
+ * form of the template itself, are renamed to fresh symbols for each expansion.
+ * This prevents the capture of pattern variable arguments by local variables of
+ * the template. Quoted template parts are never renamed.
+ *
+ * A free template symbol, which is globally bound to a syntactic keyword or primary
+ * function at compilation, refers to its binding at the macro definition: if the macro
+ * call rebinds the symbol locally, the expansion inserts the value of the definition
+ * binding instead of the symbol. All other inserted symbols refer to the binding at
+ * the macro call and a local binding of a free symbol by the Scheme::expand_all
+ * pre-expansion, which doesn't bind environments, isn't recognised.
+ */
+class SyntaxRules {
+public:
+    /**
+     * Compile the syntax rules.
+     * @param literals Literal symbol list or custom ellipsis symbol.
+     * @param rules    Syntax rule list, prepended by the literal symbol list for a custom ellipsis.
+     */
+    SyntaxRules(Scheme& scm, const Cell& literals, const Cell& rules);
+
+    /**
+     * Return the expansion of a macro call.
+     * @param senv Environment of the macro definition.
+     * @param env  Environment of the macro call.
+     * @param expr Macro call expression (keyword arg0 ... arg_n).
+     */
+    Cell expand(Scheme& scm, const SymenvPtr& senv, const SymenvPtr& env, const Cell& expr) const;
+
+private:
+    //! Match or constructor instruction.
+    struct Node {
+        enum class Op : unsigned char {
+            any, //!< Pattern wildcard _.
+            var, //!< Pattern variable.
+            symbol, //!< Pattern literal or inserted template symbol.
+            free, //!< Free template symbol of a global syntactic keyword or primary function.
+            datum, //!< Constant pattern datum or constant template part.
+            list, //!< List of the following count nodes and an optional tail node.
+            vector //!< Vector of the following count nodes.
+        };
+        Op op = Op::any;
+        bool tail = false; //!< List node has a tail node.
+        bool ellipsis = false; //!< Pattern list or vector node has an ellipsis item.
+        unsigned repeat = 0; //!< Number of ellipses following this list or vector item.
+        size_t index = 0; //!< Variable slot or first item node.
+        size_t count = 0; //!< Number of list or vector items.
+        size_t vars = 0, vars_end = 0; //!< Range of variable slots of this node in the slot table.
+        Cell value; //!< Symbol or datum.
+    };
+
+    //! Compiled syntax rule.
+    struct Rule {
+        size_t pattern; //!< Pattern root node.
+        size_t tmpl; //!< Template root node.
+        size_t depth; //!< Offset of the variable ellipsis depths in the depth table.
+        size_t size; //!< Number of pattern variables.
+    };
+    struct Match;
+    struct Compiler;
+    struct Builder;
+
+    bool match(size_t node, const Cell& expr, std::pmr::vector<Match>& slots) const;
+
+    template <typename Next>
+    bool match_items(const Node& node, size_t size, Next&& next, std::pmr::vector<Match>& slots) const;
+
+    Symbol ellipsis; //!< Ellipsis symbol.
+    std::pmr::vector<Symbol> literals; //!< Literal symbols.
+    std::pmr::vector<Node> nodes; //!< Instruction table of all patterns and templates.
+    std::pmr::vector<size_t> slots; //!< Variable slots of all nodes.
+    std::pmr::vector<unsigned> depths; //!< Ellipsis depth of all pattern variables.
+    std::pmr::vector<Rule> rules;
+};
+
+} // namespace pscm
+
+#endif // SYNTAX_HPP
@@ -0,0 +1,220 @@
+/********************************************************************************/ /**
+ * @file translator.cpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include "parser.hpp"
+#include "scheme.hpp"
+#include "translator.hpp"
+
+namespace pscm {
+
+using namespace std::string_literals;
+
+namespace {
+    //! Return the C++ string literal of a byte encoded utf-8 string.
+    std::string literal(const std::string& str)
+    {
+        std::ostringstream os;
+        os << '"';
+
+        for (unsigned char c : str)
+            if (c == '"' || c == '\\')
+                os << '\\' << c;
+            else if (std::isprint(c) && c != '?')
+                os << c;
+            else // three digit octal escape sequence can't swallow the next character
+                os << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<unsigned>(c) << std::dec;
+
+        os << '"';
+        return os.str();
+    }
+
+    //! Return the C++ expression of a floating point number.
+    std::string literal(Float x)
+    {
+        std::ostringstream os;
+
+        if (std::isnan(x))
+            os << "std::numeric_limits<Float>::quiet_NaN()";
+        else if (std::isinf(x))
+            os << (x < 0 ? "-" : "") << "std::numeric_limits<Float>::infinity()";
+        else
+            os << std::hexfloat << x;
+
+        return os.str();
+    }
+
+    //! Return the C++ expression of a number.
+    std::string literal(const Number& num)
+    {
+        if (is_int(num)) {
+            Int i = get<Int>(num);
+
+            return i == std::numeric_limits<Int>::min()
+                ? "Number{ std::numeric_limits<Int>::min() }"s
+                : "Number{ Int{ "s + std::to_string(i) + " } }";
+        }
+        if (is_float(num))
+            return "Number{ Float{ " + literal(get<Float>(num)) + " } }";
+
+        const Complex& z = get<Complex>(num);
+        return "Number{ Complex{ " + literal(z.real()) + ", " + literal(z.imag()) + " } }";
+    }
+}
+
+void Translator::translate(const String& filename, std::ostream& out, const std::string& name)
+{
+    using port_type = FilePort<Char>;
+    port_type in{ filename, port_type::in };
+
+    if (!in.is_open())
+        throw std::ios_base::failure("couldn't open input file: '"s
+            + string_convert<char>(filename) + "'"s);
+
+    (!name.empty() && !std::isdigit(static_cast<unsigned char>(name[0]))
+        && std::all_of(name.begin(), name.end(), [](unsigned char c) { return std::isalnum(c) || c == '_'; }))
+        || (void(throw std::invalid_argument("translate-file - invalid C++ identifier")), 0);
+
+    out << "// Scheme script " << name << ", translated from " << string_convert<char>(filename) << ".\n"
+        << "#include <limits>\n"
+        << "#include <string_view>\n\n"
+        << "#include \"scheme.hpp\"\n\n"
+        << "namespace {\n\n"
+        << "using namespace pscm;\n";
+
+    Parser parser{ scm };
+    std::string error;
+    size_t size = 0;
+
+    for (;;) {
+        Cell expr = none;
+
+        // Stop at the first error, where Scheme::load also stops:
+        try {
+            if (in.eof())
+                break;
+
+            expr = parser.read(in);
+        } catch (const std::exception& e) {
+            error = e.what();
+            break;
+        }
+        if (is_char(expr) && get<Char>(expr) == static_cast<Char>(EOF))
+            break;
+
+        std::ostringstream body;
+        symbols.clear();
+        count = 0;
+        std::string val = expression(body, expr);
+
+        out << "\nCell expr_" << size++ << "(Scheme& scm)\n{\n"
+            << body.str()
+            << "    return " << val << ";\n}\n";
+    }
+    out << "\nCell expr(Scheme& scm, size_t index)\n{\n"
+        << "    switch (index) {\n";
+
+    for (size_t i = 0; i < size; ++i)
+        out << "    case " << i << ":\n"
+            << "        return expr_" << i << "(scm);\n";
+
+    out << "    default:\n"
+        << "        return none;\n"
+        << "    }\n"
+        << "}\n"
+        << "} // namespace\n\n"
+        << "extern const pscm::Script " << name << ";\n"
+        << "const pscm::Script " << name << "{ " << size << ", expr, "
+        << (error.empty() ? "nullptr"s : literal(error)) << " };\n";
+}
+
+/**
+ * Write the statements to construct an expression.
+ * @return C++ expression of the expression value.
+ */
+std::string Translator::expression(std::ostream& out, const Cell& expr)
+{
+    if (is_pair(expr)) {
+        std::vector<std::string> items;
+        Cell iter = expr;
+
+        for (/* */; is_pair(iter); iter = cdr(iter))
+            items.push_back(expression(out, car(iter)));
+
+        std::string tail = expression(out, iter), var = "v" + std::to_string(count++);
+        out << "    Cell " << var << " = " << tail << ";\n";
+
+        // Cons the list from its end, so that arbitrary long lists don't nest:
+        for (auto item = items.rbegin(); item != items.rend(); ++item)
+            out << "    " << var << " = scm.cons(" << *item << ", " << var << ");\n";
+
+        return var;
+    }
+    if (is_vector(expr)) {
+        const auto& vec = *get<VectorPtr>(expr);
+        std::vector<std::string> items;
+
+        for (const Cell& item : vec)
+            items.push_back(expression(out, item));
+
+        std::string var = "v" + std::to_string(count++);
+        out << "    VectorPtr " << var << " = scm.vec();\n"
+            << "    " << var << "->reserve(" << items.size() << ");\n";
+
+        for (const std::string& item : items)
+            out << "    " << var << "->push_back(" << item << ");\n";
+
+        return var;
+    }
+    if (is_symbol(expr))
+        return symbol(out, get<Symbol>(expr));
+
+    if (is_string(expr)) {
+        std::string str = string_convert<char>(*get<StringPtr>(expr));
+        return "scm.str(string_convert<Char>(std::string_view{ " + literal(str) + ", " + std::to_string(str.size()) + " }))";
+    }
+    if (is_number(expr))
+        return "Cell{ " + literal(get<Number>(expr)) + " }";
+
+    if (is_char(expr))
+        return "Cell{ static_cast<Char>(" + std::to_string(static_cast<long>(get<Char>(expr))) + ") }";
+
+    if (is_bool(expr))
+        return is_true(expr) ? "Cell{ true }" : "Cell{ false }";
+
+    if (is_nil(expr))
+        return "Cell{ nil }";
+
+    // A compiled regular expression doesn't keep its source string:
+    throw std::invalid_argument("translate-file - regular expression literals are unsupported");
+}
+
+//! Return the name of the local variable of a symbol, which is declared at its first use.
+std::string Translator::symbol(std::ostream& out, const Symbol& sym)
+{
+    std::string name = string_convert<char>(sym.value());
+    auto pos = symbols.find(name);
+
+    if (pos != symbols.end())
+        return pos->second;
+
+    std::string var = "s" + std::to_string(symbols.size());
+    out << "    const Cell " << var << " = scm.symbol(std::string_view{ "
+        << literal(name) << ", " << name.size() << " });\n";
+
+    return symbols[name] = var;
+}
+
+} // namespace pscm
@@ -0,0 +1,70 @@
+/********************************************************************************/ /**
+ * @file translator.hpp
+ *
+ * @version   0.1
+ * @date      2018-
+ * @author    Paul Pudewills
+ * @copyright MIT License
+ *************************************************************************************/
+#ifndef TRANSLATOR_HPP
+#define TRANSLATOR_HPP
+
+#include <map>
+#include <ostream>
+#include <string>
+
+#include "cell.hpp"
+
+namespace pscm {
+
+class Scheme;
+
+/**
+ * Ahead-of-time translator of a scheme source file into C++ source of a ::Script.
+ *
+ * @verbatim
+ * (translate-file "boot.scm" "boot.cpp" "boot_script")
+ * @endverbatim
+ *
+ * The translated source defines a global constant of type pscm::Script, which
+ * constructs each top-level expression of the source file directly from cons-cells,
+ * symbols and atoms, instead of parsing it at runtime:
+ *
+ * @code{.cpp}
+ * extern const pscm::Script boot_script;
+ *
+ * scm.load(boot_script);
+ * @endcode
+ *
+ * Scheme::load evaluates the expressions of a script exactly as the expressions of the
+ * source file. A parse error of the source file is translated into the same error,
+ * raised after the evaluation of all preceding expressions.
+ */
+class Translator {
+public:
+    explicit Translator(Scheme& scm)
+        : scm{ scm }
+    {
+    }
+
+    /**
+     * Translate a scheme source file into C++ source.
+     *
+     * @param filename Scheme source file name.
+     * @param out      Output stream of the C++ source.
+     * @param name     C++ identifier of the script constant.
+     */
+    void translate(const String& filename, std::ostream& out, const std::string& name);
+
+private:
+    std::string expression(std::ostream& out, const Cell& expr);
+    std::string symbol(std::ostream& out, const Symbol& sym);
+
+    Scheme& scm;
+    std::map<std::string, std::string> symbols; //!< Local variable names of the symbols of an expression.
+    size_t count = 0; //!< Number of local variables of an expression.
+};
+
+} // namespace pscm
+
+#endif // TRANSLATOR_HPP
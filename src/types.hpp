@@ -10,6 +10,7 @@
 #define TYPES_HPP
 
 #include <map>
+#include <memory_resource>
 #include <regex>
 #include <string>
 #include <variant>
@@ -30,6 +31,7 @@ struct Number;
 class  Clock;
 class  Procedure;
 class  Function;
+struct Record;
 enum class Intern;
 template<typename Cell> struct less;
 
@@ -38,12 +40,15 @@ using Nil         = std::nullptr_t;
 using Bool        = bool;
 using Char        = MYCHAR;
 using Cons        = std::tuple</*car*/Cell, /*cdr*/Cell, /*gc-mark*/bool>;
-using String      = std::basic_string<Char>;
+using String      = std::pmr::basic_string<Char>;
+using Vector      = std::pmr::vector<Cell>;
+using Map         = std::pmr::multimap<Cell,Cell,less<Cell>>;
 using StringPtr   = std::shared_ptr<String>;
 using ClockPtr    = std::shared_ptr<Clock>;
 using RegexPtr    = std::shared_ptr<std::basic_regex<Char>>;
-using MapPtr      = std::shared_ptr<std::multimap<Cell,Cell,less<Cell>>>;
-using VectorPtr   = std::shared_ptr<std::vector<Cell>>;
+using MapPtr      = std::shared_ptr<Map>;
+using RecordPtr   = std::shared_ptr<Record>;
+using VectorPtr   = std::shared_ptr<Vector>;
 using PortPtr     = std::shared_ptr<Port<Char>>;
 using FunctionPtr = std::shared_ptr<Function>;
 using Symtab      = SymbolTable<String>;
@@ -63,7 +68,7 @@ using Variant = std::variant <
     Cons*, StringPtr, VectorPtr, PortPtr, FunctionPtr, SymenvPtr,
 
     /* Extensions: */
-    RegexPtr, ClockPtr, MapPtr
+    RegexPtr, ClockPtr, MapPtr, RecordPtr
 >;
 
 static const None none {}; //!< void return symbol
@@ -85,6 +90,12 @@ enum class Intern {
     _begin,
     _lambda,
     _macro,
+    _define_syntax,
+    _define_record_type,
+    _syntax_rules,
+    _receive,
+    _let_values,
+    _values, //!< Marker of a multiple values result.
     _apply,
     _quote,
     _quasiquote,
@@ -293,6 +304,11 @@ enum class Intern {
     /* Section 6.11: Exceptions */
     op_error,
     op_with_exception,
+    op_raise,
+    op_raisecont,
+    op_iserrobj,
+    op_errobjmsg,
+    op_errobjirr,
 
     /* Section 6.12: Environments and evaluation */
     op_exit,
@@ -301,6 +317,12 @@ enum class Intern {
     op_eval,
     op_gc,
     op_gcdump,
+    op_optimize,
+    op_compile,
+    op_depth_limit,
+    op_eval_budget,
+    op_memory_budget,
+    op_frame_pool,
     op_macroexp,
 
     /* Section 6.13: Input and output */
@@ -357,6 +379,8 @@ enum class Intern {
 
     /* Section 6.14: System Interface */
     op_load,
+    op_expand_file,
+    op_translate_file,
     op_fileok,
     op_delfile,
     op_cmdline,
@@ -393,6 +417,17 @@ enum class Intern {
     op_dict2list,
     op_list2dict,
 
+    /* Section extensions: coroutines */
+    op_make_coroutine,
+    op_close_coroutine,
+    op_yield,
+    op_spawn,
+    op_sleep,
+    op_make_channel,
+    op_channel_send,
+    op_channel_receive,
+    op_run_threads,
+
     op_usecount,
     op_hash,
 };
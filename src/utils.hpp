@@ -11,6 +11,7 @@
 
 #include <codecvt>
 #include <locale>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <variant>
@@ -65,7 +66,8 @@ std::basic_string<CharT> s2ws(const StringT& str)
 
     using convert_type = std::codecvt_utf8<CharT>;
     static std::wstring_convert<convert_type, CharT> converter;
-    return converter.from_bytes(str);
+    std::basic_string_view<char> view{ str };
+    return converter.from_bytes(view.data(), view.data() + view.size());
 }
 
 //! Convert a string of type StringT into a byte encoded
@@ -76,17 +78,19 @@ std::basic_string<char> ws2s(const StringT& str)
     using CharT = typename char_traits<StringT>::char_type;
     using convert_type = std::codecvt_utf8<CharT>;
     static std::wstring_convert<convert_type, CharT> converter;
-    return converter.to_bytes(str);
+    std::basic_string_view<CharT> view{ str };
+    return converter.to_bytes(view.data(), view.data() + view.size());
 }
 
-//! Convert a string of type StringT into a std::basic_string<CharT>
+//! Convert a string of type StringT into a std::basic_string<CharT>. StringT might
+//! be a null-terminated character buffer or a string class with any allocator.
 template <typename CharT, typename StringT, typename = std::enable_if_t<std::is_integral_v<CharT>>>
 std::basic_string<CharT> string_convert(const StringT& str)
 {
     using value_type = typename char_traits<StringT>::char_type;
 
     if constexpr (std::is_same_v<CharT, value_type>)
-        return str;
+        return std::basic_string<CharT>{ std::basic_string_view<CharT>{ str } };
 
     else if constexpr (std::is_same_v<char, value_type>)
         return s2ws<CharT>(str);
@@ -3,136 +3,53 @@
 ;; PicoScheme initialization file to be loaded on each start-up
 ;;
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
-;;
-;; Quasiquote macro copied from Peter Norvig's JScheme, see http://www.norvig.com
-;;
-(define-macro  (quasiquote x)
-
-  (define (constant? exp)
-    (if (pair? exp)
-        (eq? (car exp) 'quote)
-        (not (symbol? exp))))
-
-  (define (combine-skeletons left right exp)
-    (cond
-     ((and (constant? right) (constant? left))
-      (if (and (eqv? (eval left)  (car exp))
-               (eqv? (eval right) (cdr exp)))
-          (list 'quote exp)
-          (list 'quote (cons (eval left) (eval right)))))
-
-     ((null? right)
-      (list 'list left))
-
-     ((and (pair? right) (eq? (car right) 'list))
-      (cons 'list (cons left (cdr right))))
-
-     (else
-      (list 'cons left right))))
-
-  (define (expand-quasiquote exp nesting)
-    (cond
-     ((vector? exp)
-      (list 'apply 'vector (expand-quasiquote (vector->list exp) nesting)))
-
-     ((not (pair? exp))
-      (if (constant? exp)
-          exp (list 'quote exp)))
-
-     ((and (eq? (car exp) 'unquote) (= (length exp) 2))
-      (if (= nesting 0)
-          (cadr exp)
-          (combine-skeletons ''unquote
-                             (expand-quasiquote (cdr exp) (- nesting 1))
-                             exp)))
-
-     ((and (eq? (car exp) 'quasiquote) (= (length exp) 2))
-      (combine-skeletons ''quasiquote
-                         (expand-quasiquote (cdr exp) (+ nesting 1))
-                         exp))
-
-     ((and (pair? (car exp))
-           (eq? (caar exp) 'unquote-splicing)
-           (= (length (car exp)) 2))
-
-      (if (= nesting 0)
-          (list 'append (cadr (car exp))
-                (expand-quasiquote (cdr exp) nesting))
-          (combine-skeletons (expand-quasiquote (car exp) (- nesting 1))
-                             (expand-quasiquote (cdr exp) nesting)
-                             exp)))
-     (else
-      (combine-skeletons (expand-quasiquote (car exp) nesting)
-                         (expand-quasiquote (cdr exp) nesting) exp))))
-
-  (expand-quasiquote x 0))
-
-;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
-(define-macro (let bindings . body)
-  (define (varval v)
-    (string->symbol (string-append (symbol->string v) "=")))
-
-  (define (named-let name bindings body)
-    ((lambda (new-bindings)
-       `(let ,(cons `(,name #f) new-bindings)
-          (set! ,name (lambda ,(map car bindings) . ,body))
-          (,name . ,(map car  new-bindings))))
-     (map (lambda (b)
-            `(,(varval (car b)) ,(cadr b))) bindings)))
-
-  (if (symbol? bindings)
-      (named-let bindings (car body) (cdr body))
-      `((lambda ,(map car bindings) . ,body) . ,(map cadr bindings))))
-
-(define-macro  (let* bindings . body)
-  (if (null? bindings) `((lambda () . ,body))
-      `(let (,(car bindings))
-         (let* ,(cdr bindings) . ,body))))
-
-(define-macro (letrec bindings . body)
-  (let ((vars (map car  bindings))
-        (vals (map cadr bindings)))
-
-    `(let ,(map (lambda (var)
-                  `(,var #f)) vars)
-
-       ,@(map (lambda (var val)
-                `(set! ,var ,val)) vars vals)
-       . ,body)))
+;; Derived expression types as compiled syntax-rules macros:
+(define-syntax let
+  (syntax-rules ()
+    ((_ ((name val) ...) body1 body2 ...)
+     ((lambda (name ...) body1 body2 ...) val ...))
+    ((_ tag ((name val) ...) body1 body2 ...)
+     ((letrec ((tag (lambda (name ...) body1 body2 ...))) tag) val ...))))
+
+(define-syntax let*
+  (syntax-rules ()
+    ((_ () body1 body2 ...)
+     ((lambda () body1 body2 ...)))
+    ((_ (binding) body1 body2 ...)
+     (let (binding) body1 body2 ...))
+    ((_ (binding rest ...) body1 body2 ...)
+     (let (binding) (let* (rest ...) body1 body2 ...)))))
+
+(define-syntax letrec
+  (syntax-rules ()
+    ((_ ((var val) ...) body1 body2 ...)
+     (let ((var #f) ...)
+       (set! var val) ...
+       body1 body2 ...))))
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
-(define-macro (do bindings test-and-result . body)
-  (let ((variables (map car bindings))
-        (inits     (map cadr bindings))
-        (steps     (map (lambda (clause)
-                          (if (null? (cddr clause))
-                              (car clause)
-                              (caddr clause)))
-                        bindings))
-        (test   (car test-and-result))
-        (result (cdr test-and-result))
-        (loop   (gensym)))
-
-    `(letrec ((,loop (lambda ,variables
-                       (if ,test
-                           ,(if (not (null? result))
-                                `(begin . ,result))
-                           (begin
-                             ,@body
-                             (,loop . ,steps))))))
-       (,loop . ,inits)) ))
+(define-syntax do
+  (syntax-rules ()
+    ((_ ((var init step ...) ...) (test expr ...) command ...)
+     (letrec ((loop (lambda (var ...)
+                      (if test
+                          (begin (if #f #f) expr ...)
+                          (begin command ...
+                                 (loop (do "step" var step ...) ...))))))
+       (loop init ...)))
+    ((_ "step" x) x)
+    ((_ "step" x y) y)))
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
-(define-macro (case expr . cases)
-  (let ((item (gensym)))
-
-    (define (do-case case)
-      (cond ((not (pair? case)) (error "bad syntax in case" case))
-            ((eq? (car case) 'else) case)
-            (else `((member ,item ',(car case)) . ,(cdr case)))))
-
-    `(let ((,item ,expr))
-       (cond . ,(map do-case cases)))))
+(define-syntax case
+  (syntax-rules (else)
+    ((_ key ((data ...) expr1 expr2 ...) ... (else else1 else2 ...))
+     (let ((item key))
+       (cond ((member item '(data ...)) expr1 expr2 ...) ...
+             (else else1 else2 ...))))
+    ((_ key ((data ...) expr1 expr2 ...) ...)
+     (let ((item key))
+       (cond ((member item '(data ...)) expr1 expr2 ...) ...)))))
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;;
@@ -8,7 +8,7 @@
 ;;; and the IEEE specification.
 ;;;
 ;;; The input tests read this file expecting it to be named "r4rstest.scm".
-;;; Files `tmp1', `tmp2' and `tmp3' will be created in the course of running
+;;; Files `tmp1', `tmp2', `tmp3' and `tmp4' will be created in the course of running
 ;;; these tests.  You may need to delete them in order to run
 ;;; "r4rstest.scm" more than once.
 ;;;
@@ -1456,6 +1456,437 @@
   (test write-test-obj 'load foo)
   (report-errs))
 
+;;; Tests of the PicoScheme extensions
+(SECTION 'define-syntax)
+(define-syntax swap!
+  (syntax-rules ()
+    ((_ a b) (let ((tmp a)) (set! a b) (set! b tmp)))))
+(test '(6 5) 'swap! (let ((tmp 5) (other 6)) (swap! tmp other) (list tmp other)))
+(define-syntax my-or
+  (syntax-rules ()
+    ((_) #f)
+    ((_ e) e)
+    ((_ e r ...) (let ((t e)) (if t t (my-or r ...))))))
+(test 7 'my-or (let ((t 7)) (my-or #f t)))
+(test #f 'my-or (my-or))
+(define-syntax arrow
+  (syntax-rules (=>)
+    ((_ a => b) (list 'arrow a b))
+    ((_ a b) (list 'plain a b))))
+(test '((arrow 1 2) (plain 1 2)) 'syntax-rules (list (arrow 1 => 2) (arrow 1 2)))
+(define-syntax flat
+  (syntax-rules ()
+    ((_ (n v ...) ...) '((n ...) (v ... ...)))))
+(test '((a b) (1 2 3)) 'syntax-rules (flat (a 1 2) (b 3)))
+(define s-expr (list 'syntax-rules '() '((_ a) a)))
+(define-syntax s-id (eval s-expr (interaction-environment)))
+(test '() 'syntax-rules (cadr s-expr))
+(define-syntax my-if
+  (syntax-rules ()
+    ((_ c a b) (cond (c a) (else b)))))
+(test 2 'syntax-rules (let ((else #f)) (my-if #f 1 2)))
+(test 1 'syntax-rules (let ((cond list)) (my-if #t 1 2)))
+(define-syntax first-of
+  (syntax-rules ()
+    ((_ x) (car x))))
+(test 1 'syntax-rules (let ((car cdr)) (first-of '(1 2))))
+(define-syntax case-one
+  (syntax-rules ()
+    ((_ x) (case x ((1) 'one) (else 'other)))))
+(test '(one other) 'syntax-rules (list (case-one 1) (case-one 2)))
+
+(SECTION 'memory-budget)
+(define mem-used (memory-budget))
+(memory-budget (+ mem-used 200000))
+(test "out of memory" 'memory-budget
+      (with-exception-handler (lambda (e) (car e)) (lambda () (make-vector 100000 0))))
+(define (mem-grow lst) (mem-grow (cons 0 lst)))
+(test "out of memory" 'memory-budget
+      (with-exception-handler (lambda (e) (car e)) (lambda () (mem-grow '()))))
+(test #t 'memory-budget (< (memory-budget) (+ mem-used 100000)))
+(test 1000 'memory-budget (vector-length (make-vector 1000 0)))
+(memory-budget 0)
+
+(SECTION 'symbol-table)
+(define (make-symbols n)
+  (if (> n 0)
+      (begin (string->symbol (string-append "tmp-symbol-" (number->string n)))
+             (make-symbols (- n 1)))))
+(make-symbols 1000)
+(define kept-symbol (string->symbol "tmp-symbol-7"))
+(define sym-used (memory-budget))
+(make-symbols 1000)
+(make-symbols 1000)
+(test #t 'symbol-table (< (memory-budget) (+ sym-used 10000)))
+(test #t eq? kept-symbol (string->symbol "tmp-symbol-7"))
+(test "tmp-symbol-7" symbol->string kept-symbol)
+
+(SECTION 'environment)
+(define (binding-names n)
+  (if (= n 0)
+      '()
+      (cons (string->symbol (string-append "flat-" (number->string n))) (binding-names (- n 1)))))
+(define flat-names (binding-names 40))
+(define flat-proc
+  (eval `(lambda (x)
+           ,@(map (lambda (s) `(define ,s ',s)) flat-names)
+           (set! flat-3 x)
+           (vector ,@flat-names))
+        (interaction-environment)))
+(define flat-vector (flat-proc 3))
+(test 40 vector-length flat-vector)
+(test '(flat-40 flat-20 flat-4 3 flat-2 flat-1) 'environment
+      (map (lambda (k) (vector-ref flat-vector k)) '(0 20 36 37 38 39)))
+(define (repeat n thunk) (if (> n 0) (begin (thunk) (repeat (- n 1) thunk))))
+(test #t 'environment
+      (let ((used (begin (flat-proc 1) (memory-budget))))
+        (repeat 100 (lambda () (flat-proc 1)))
+        (< (memory-budget) (+ used 1000))))
+
+(SECTION 'leaf-frames)
+(define (leaf-depth n) (if (= n 0) 0 (+ 1 (leaf-depth (- n 1)))))
+(define leaf-used (memory-budget))
+(test 50 'leaf-frames (leaf-depth 50))
+(test #t 'leaf-frames (< (memory-budget) (+ leaf-used 10000)))
+(define (leaf-rest . xs) (if (null? xs) 0 (+ (car xs) (apply leaf-rest (cdr xs)))))
+(test 6 'leaf-frames (leaf-rest 1 2 3))
+(define (leaf-live n) (if (= n 0) (frame-pool) (+ 0 (leaf-live (- n 1)))))
+(test #t 'frame-pool (>= (leaf-live 5) 5))
+(define (leaf-loop n) (if (> n 0) (begin (leaf-depth 20) (leaf-loop (- n 1))) 'done))
+(test 'done leaf-loop 1000)
+(define pool-state (list (frame-pool) (frame-pool #t)))
+(test '(0 #t) 'frame-pool pool-state)
+(define (leaf-fail n) (if (= n 0) (raise 'leaf-error) (+ 1 (leaf-fail (- n 1)))))
+(test 'leaf-error 'frame-pool (with-exception-handler (lambda (e) e) (lambda () (leaf-fail 20))))
+(define pool-state (list (frame-pool) (frame-pool #t)))
+(test '(0 #t) 'frame-pool pool-state)
+
+(SECTION 'closure-template)
+(define lambda-expr (list 'lambda '(x) 'x))
+(test 5 (eval lambda-expr (interaction-environment)) 5)
+(test '(x) 'eval (cadr lambda-expr))
+(test 'lambda 'eval (car lambda-expr))
+(define (make-adder n) (lambda (x) (+ x n)))
+(test '(3 4) 'closure-template (list ((make-adder 1) 2) ((make-adder 2) 2)))
+
+(SECTION 'free-variables)
+(define (make-later y) (lambda () (later)))
+(define later-thunk (make-later 5))
+(define-macro (later) 'y)
+(test 5 later-thunk)
+(define (make-counter)
+  (let ((n 0) (unused (make-vector 100 0)))
+    (lambda () (set! n (+ n 1)) n)))
+(define counter (make-counter))
+(counter)
+(test 2 counter)
+
+(SECTION 'optimize)
+(optimize #t)
+(define order '())
+(define (note x) (set! order (cons x order)) x)
+(define (sub a b) (- b a))
+(define (sub-order) (sub (note 1) (note 2)))
+(test 1 sub-order)
+(test '(2 1) 'optimize order)
+(define global-x 10)
+(define (sub-global) (sub (begin (set! global-x 1) 0) global-x))
+(test 1 sub-global)
+(define (fold-const) (* (+ 1 2) 4))
+(test 12 fold-const)
+(optimize #f)
+
+(SECTION 'quasiquote)
+(test '(1 `(2 ,(3 4 5))) 'quasiquote `(1 `(2 ,(3 ,@(list 4 5)))))
+(test '#(1 `#(2 ,(+ 1 2)) 3) 'quasiquote `#(1 `#(2 ,(+ 1 2)) ,(+ 1 2)))
+(test '((a 1) (a 2)) 'quasiquote (let ((f (lambda (y) `(a ,y)))) (list (f 1) (f 2))))
+(test '(x 1 . 2) 'quasiquote (let ((d 2)) `(x 1 . ,d)))
+
+(SECTION 'expand-file)
+(call-with-output-file "tmp3"
+  (lambda (port)
+    (write '(define-macro (twice x) (list 'begin x x)) port)
+    (write '(define (count-twice n) (twice (set! n (+ n 1))) n) port)))
+(test '(define (count-twice n) (begin (set! n (+ n 1)) (set! n (+ n 1))) n)
+      'expand-file (cadr (expand-file "tmp3")))
+(test 2 'expand-file (begin (load "tmp3") (count-twice 0)))
+(delete-file "tmp3")
+(test #f file-exists? "tmp3")
+
+(SECTION 'values)
+(test 3 call-with-values (lambda () (values 1 2)) +)
+(test '(1 2 (3 4)) 'receive (receive (a b . rest) (values 1 2 3 4) (list a b rest)))
+(test '(1 2) 'receive (receive all (values 1 2) all))
+(test '(1 2 3 (4 5)) 'let-values
+      (let-values (((a b) (values 1 2)) ((c) (values 3)) (d (values 4 5))) (list a b c d)))
+(test '(8 7) 'let-values (let ((x 7)) (let-values (((x y) (values (+ x 1) x))) (list x y))))
+
+(define (values-error thunk)
+  (with-exception-handler (lambda (e) (car e)) thunk))
+(test "multiple values in a single value context" 'values
+      (values-error (lambda () (define v (values 1 2)) v)))
+(test "multiple values in a single value context" 'values
+      (values-error (lambda () (let ((v 0)) (set! v (values 1 2)) v))))
+(test "multiple values in a single value context" 'values
+      (values-error (lambda () (list (values 1 2)))))
+(test "multiple values in a single value context" 'values
+      (values-error (lambda () ((lambda (x) x) (values 1 2)))))
+(test "multiple values in a single value context" 'values
+      (values-error (lambda () (if (values #f #f) 1 2))))
+(test 1 'values (values 1))
+(test '(1 2) 'values (call-with-values (lambda () (if #t (values 1 2))) list))
+
+(SECTION 'depth-limit)
+(define (depth n) (if (= n 0) 0 (+ 1 (depth (- n 1)))))
+(define saved-depth-limit (depth-limit 100))
+(test '("recursion depth exceeded" 100) 'depth-limit
+      (with-exception-handler (lambda (e) e) (lambda () (depth 1000))))
+(depth-limit 1000000000)
+(test "recursion depth exceeded" 'depth-limit
+      (with-exception-handler (lambda (e) (car e)) (lambda () (depth 100000000))))
+(depth-limit saved-depth-limit)
+(test #t 'depth-limit (>= (depth-limit) 10000))
+(test 1000 depth 1000)
+
+(SECTION 'coroutine)
+(define co-gen (make-coroutine (lambda () (yield 1) (yield 2) 'done)))
+(test 1 co-gen)
+(test 2 co-gen)
+(test 'done co-gen)
+(test #t eof-object? (co-gen))
+(define co-echo (make-coroutine (lambda () (let loop ((x (yield 'ready))) (loop (yield (* x 2)))))))
+(test 'ready co-echo)
+(test 10 co-echo 5)
+(close-coroutine co-echo)
+(test #t eof-object? (co-echo 7))
+(define (co-walk tree)
+  (cond ((null? tree) 'end)
+        ((pair? tree) (co-walk (car tree)) (co-walk (cdr tree)))
+        (else (yield tree))))
+(define co-leaves (make-coroutine (lambda () (co-walk '((1 2) (3 (4 5)) 6)))))
+(define (co-collect co) (let ((x (co))) (if (eq? x 'end) '() (cons x (co-collect co)))))
+(test '(1 2 3 4 5 6) co-collect co-leaves)
+(define co-keep (make-coroutine (lambda () (let ((lst (list 1 2 3))) (yield 'ready) (apply + lst)))))
+(test 'ready co-keep)
+(gc)
+(define co-garbage (make-vector 100 (list 4 5 6)))
+(test 6 co-keep)
+(define (co-count n) (if (= n 0) 0 (+ 1 (co-count (- n 1)))))
+(define co-deep (make-coroutine (lambda () (co-count 100000000))))
+(test "recursion depth exceeded" 'coroutine
+      (with-exception-handler (lambda (e) (car e)) (lambda () (co-deep))))
+(define co-capped (make-coroutine (lambda () (co-count (depth-limit)))))
+(test #t 'coroutine
+      (with-exception-handler (lambda (e) (< (cadr e) (depth-limit))) (lambda () (co-capped))))
+(test 1000 (make-coroutine (lambda () (co-count 1000))))
+(define co-raise (make-coroutine (lambda () (yield 1) (raise 'boom))))
+(co-raise)
+(test 'boom 'coroutine (with-exception-handler (lambda (e) e) (lambda () (co-raise))))
+(test #t eof-object? (co-raise))
+
+(SECTION 'green-threads)
+(define co-chan (make-channel))
+(spawn (lambda () (channel-send co-chan 'a) (yield) (channel-send co-chan 'b)))
+(test 'a channel-receive co-chan)
+(test 'b channel-receive co-chan)
+(run-threads)
+(co-chan 'c)
+(test 'c co-chan)
+(define th-log '())
+(define (th-note x) (set! th-log (cons x th-log)))
+(define th-ping (make-channel))
+(define th-pong (make-channel))
+(spawn (lambda () (do ((i 0 (+ i 1))) ((= i 3)) (th-ping i) (th-note (th-pong)))))
+(spawn (lambda () (do ((i 0 (+ i 1))) ((= i 3)) (th-pong (* 10 (channel-receive th-ping))))))
+(run-threads)
+(test '(0 10 20) 'green-threads (reverse th-log))
+(set! th-log '())
+(spawn (lambda () (sleep 30) (th-note 'slow)))
+(spawn (lambda () (sleep 10) (th-note 'fast)))
+(run-threads)
+(test '(fast slow) 'green-threads (reverse th-log))
+(define (th-busy n) (if (> n 0) (th-busy (- n 1))))
+(set! th-log '())
+(spawn (lambda () (th-busy 10000) (th-note 'busy)))
+(spawn (lambda () (th-note 'quick)))
+(run-threads)
+(test '(quick busy) 'green-threads (reverse th-log))
+(define th-wait (make-channel))
+(define th-done (make-channel))
+(spawn (lambda () (let ((lst (list 1 2 3))) (th-wait) (th-done (apply + lst)))))
+(yield)
+(define th-used (memory-budget))
+(memory-budget (+ th-used 200000))
+(test "out of memory" 'green-threads
+      (with-exception-handler (lambda (e) (car e)) (lambda () (mem-grow '()))))
+(test #t 'green-threads (< (memory-budget) (+ th-used 100000)))
+(memory-budget 0)
+(th-wait 'go)
+(test 6 channel-receive th-done)
+
+(SECTION 'eval-budget)
+(define (spin n) (spin (+ n 1)))
+(test '("evaluation fuel exhausted") 'eval-budget
+      (with-exception-handler (lambda (e) e) (lambda () (eval-budget 10000) (spin 0))))
+(eval-budget 0)
+(test #f eval-budget)
+
+(eval-budget 0 50)
+(test '("evaluation deadline exceeded") 'eval-budget
+      (with-exception-handler (lambda (e) e) (lambda () (spin 0))))
+(eval-budget 0)
+
+(SECTION 'compile-numeric)
+(compile-numeric #t)
+(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+(define (sq x) (* x x))
+(define (mag x y z) (sqrt (+ (sq x) (sq y) (sq z))))
+(test 6765 fib 20)
+(test 3. mag 1. 2. 2.)
+(test 3 mag 1 2 2)
+(test -3+4i sq 1+2i)
+(define (sq x) (+ x x))
+(test 10 sq 5)
+(compile-numeric #f)
+
+(SECTION 'translate-file)
+(call-with-output-file "tmp3"
+  (lambda (port)
+    (write '(define (translate-twice n) (* 2 n)) port)
+    (write '(translate-twice 21) port)))
+(translate-file "tmp3" "tmp4" "tmp_script")
+(test "// Scheme script tmp_script, translated from tmp3." 'translate-file
+      (call-with-input-file "tmp4" read-line))
+(define (translate-last-line port)
+  (let loop ((line (read-line port)) (last ""))
+    (if (eof-object? line) last (loop (read-line port) line))))
+(test "const pscm::Script tmp_script{ 2, expr, nullptr };" 'translate-file
+      (call-with-input-file "tmp4" translate-last-line))
+(delete-file "tmp3")
+(delete-file "tmp4")
+(test #f file-exists? "tmp4")
+
+(SECTION 'binary-arithmetic)
+(define (mul a b) (* a b))
+(test 42 mul 6 7)
+(test -12 mul -3 4)
+(test 0 mul 0 -5)
+(test #t exact? (mul 6 7))
+(test 5. mul 2.5 2.)
+(test 3. mul 2 1.5)
+(test -3+4i mul 1+2i 1+2i)
+(test 7 'binary-arithmetic (+ 3 4))
+(test '(1 . 2) 'binary-arithmetic (cons 1 2))
+(test #t 'binary-arithmetic (< 1 2))
+(test 2 'binary-arithmetic (min 2 3))
+
+(SECTION 'define-record-type)
+(define-record-type <point> (make-point x y) point? (x point-x set-point-x!) (y point-y))
+(define point (make-point 1 2))
+(test #t point? point)
+(test #f point? (vector 1 2))
+(test 1 point-x point)
+(test 2 point-y point)
+(set-point-x! point 10)
+(test 10 point-x point)
+(test #f point? 'point)
+(test '(10 2) map (lambda (f) (f point)) (list point-x point-y))
+(define-record-type <node> (make-node value) node? (value node-value) (next node-next set-node-next!))
+(define node (make-node 'a))
+(set-node-next! node '())
+(test 'a node-value node)
+(test '() node-next node)
+(test #f node? point)
+
+(SECTION 'or-cond)
+(define or-x 'sym)
+(test 'sym 'or (or #f or-x))
+(test '(1 2) 'or (or #f '(1 2)))
+(test #f 'or (or #f #f))
+(test 1 'or (let ((n 0)) (or (begin (set! n (+ n 1)) n) (set! n 10))))
+(test 'sym 'cond (cond (or-x) (else #f)))
+(test '(1 2) 'cond (cond ((list 1 2)) (else #f)))
+(test 'b 'cond (cond ((assv 2 '((1 . a) (2 . b))) => cdr) (else #f)))
+(test 3 'cond (cond ((+ 1 1) => (lambda (x) (+ x 1))) (else #f)))
+(test 'else 'cond (cond ((memv 3 '(1 2)) => car) (else 'else)))
+(test 1 'cond (let ((n 0)) (cond ((begin (set! n (+ n 1)) n) => (lambda (x) x)))))
+(define (cond-loop n) (cond ((> n 0) => (lambda (x) (cond-loop (- n 1)))) (else 'done)))
+(test 'done cond-loop 100000)
+(test #t 'or-cond
+      (let ((used (begin (repeat 10 (lambda () (or #f or-x))) (memory-budget))))
+        (repeat 1000 (lambda () (or #f or-x)))
+        (repeat 1000 (lambda () (cond ((assv 2 '((1 . a) (2 . b))) => cdr) (else #f))))
+        (< (memory-budget) (+ used 20000))))
+
+(SECTION 'rest-list)
+(define (f . xs) (length xs))
+(f 1 2 3)
+(gc)
+(test 4 f 4 5 6 7)
+(define (rest-sum . xs) (apply + xs))
+(test 6 rest-sum 1 2 3)
+(test 0 rest-sum)
+(test 10 rest-sum 1 2 3 4)
+(test 3 rest-sum 1 2)
+(define (rest-keep . xs) xs)
+(define kept-rest (rest-keep 1 2 3))
+(rest-keep 4 5 6)
+(test '(1 2 3) 'rest-list kept-rest)
+(test 6 rest-sum (rest-sum 1 2) (rest-sum 1 2) 0)
+(define (rest-make) (lambda xs (apply + xs)))
+(define rest-g (rest-make))
+(rest-g 1 2 3)
+(set! rest-g #f)
+(gc)
+(set! rest-g (rest-make))
+(gc)
+(test 3 rest-g 1 2)
+(gc)
+(test 7 f 1 2 3 4 5 6 7)
+
+(SECTION 'call/cc-escape)
+(test 42 call-with-current-continuation (lambda (k) (+ 1 (k 42))))
+(test -2 'call/cc-escape
+      (call/cc (lambda (k) (for-each (lambda (x) (if (negative? x) (k x))) '(1 -2 3)) 0)))
+(define (escape-deep k n) (if (= n 0) (k 'bottom) (+ 1 (escape-deep k (- n 1)))))
+(test 'bottom call/cc (lambda (k) (escape-deep k 500)))
+(test 10 'call/cc-escape (call/cc (lambda (outer) (+ 1 (call/cc (lambda (inner) (outer 10)))))))
+(test 11 'call/cc-escape (+ 1 (call/cc (lambda (outer) (call/cc (lambda (inner) (inner 10)))))))
+(test '(1 escaped) 'call/cc-escape
+      (call-with-values (lambda () (call/cc (lambda (k) (map (lambda (x) (k 1 'escaped)) '(a b)))))
+        list))
+(test '(a 1) 'call/cc-escape
+      (call/cc (lambda (k) (apply (lambda (x y) (k (list x y))) '(a 1)))))
+(test 3 'call/cc-escape (let loop ((i 0)) (if (< i 3) (loop (+ i (call/cc (lambda (k) (k 1))))) i)))
+
+(SECTION 'handler-stack)
+(test 11 'raise-continuable
+      (with-exception-handler (lambda (e) 10) (lambda () (+ 1 (raise-continuable 'oops)))))
+(test '(outer (inner boom)) 'handler-stack
+      (with-exception-handler (lambda (e) (list 'outer e))
+        (lambda () (with-exception-handler (lambda (e) (raise (list 'inner e)))
+                     (lambda () (raise 'boom))))))
+(test 111 'handler-stack
+      (with-exception-handler (lambda (e) (* e 2))
+        (lambda () (with-exception-handler (lambda (e) (+ 1 (raise-continuable e)))
+                     (lambda () (+ 100 (raise-continuable 5)))))))
+(test '(caught err) 'handler-stack
+      (call/cc (lambda (k) (with-exception-handler (lambda (e) (k (list 'caught e)))
+                             (lambda () (raise 'err))))))
+(test 'outer 'handler-stack
+      (with-exception-handler (lambda (e) 'outer)
+        (lambda () (with-exception-handler (lambda (e) 'inner) (lambda () 'body))
+                   (raise-continuable 1))))
+(test '("bad" 1 2) 'handler-stack
+      (with-exception-handler
+          (lambda (e) (cons (error-object-message e) (error-object-irritants e)))
+        (lambda () (with-exception-handler (lambda (e) (raise e)) (lambda () (error "bad" 1 2))))))
+
+(SECTION 'values-exit)
+;; The last multiple values result of this file, which the interpreter still holds when it is destroyed.
+(define (values-syms) (values 'aa-sym 'bb-sym))
+(test '(aa-sym bb-sym) call-with-values values-syms list)
+
 (report-errs)
 
 (newline)